@@ -1,7 +1,7 @@
 #include <vector>
 #include <array>
 #include <cmath>
-#include "../../src/winhelp.hpp"
+#include "../../src/ver3/winhelp.hpp"
 
 namespace render3d {
 
@@ -113,6 +113,8 @@ namespace render3d {
         }
 
         void render(Surface &surface) {
+            WINHELP_PROFILE_SCOPE("render3d::Renderer::render");
+
             std::vector<const Face *> zSortedFaces;
 
             for (const Object &obj : objects) {
@@ -131,10 +133,15 @@ namespace render3d {
                 }
             }
 
-            for (const Face *face : zSortedFaces) {
-                Lines2D lines = getFaceLines2D(*face);
-                winhelp::draw::polygon(surface, lines, face->colour);
-            }
+            // projecting is independent per face, drawing has to stay in z order
+            std::vector<Lines2D> projected(zSortedFaces.size());
+            winhelp::jobs::parallel_for(0, (int)zSortedFaces.size(), 64, [&](int from, int to) {
+                for (int i = from; i < to; i++)
+                    projected[i] = getFaceLines2D(*zSortedFaces[i]);
+            });
+
+            for (size_t i = 0; i < zSortedFaces.size(); i++)
+                winhelp::draw::polygon(surface, projected[i], zSortedFaces[i]->colour);
         }
 
         inline void addObject(const Object &obj) {
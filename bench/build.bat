@@ -0,0 +1,13 @@
+@echo off
+REM Builds the benchmark, `build.bat run [args]` also runs it.
+g++ -std=c++20 -O2 -march=native main.c++ -lgdi32 -luser32 -o bench.exe
+if errorlevel 1 (
+    echo [BUILD]: Build failed.
+    exit /b 1
+)
+echo [BUILD]: Build succeeded!
+
+if "%1"=="run" (
+    shift
+    bench.exe %2 %3 %4 %5 %6 %7 %8 %9
+)
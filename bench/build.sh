@@ -0,0 +1,15 @@
+#!/bin/sh
+# Builds the headless benchmark, `./build.sh run [args]` also runs it.
+set -e
+cd "$(dirname "$0")"
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -march=native}
+
+"$CXX" -std=c++20 $CXXFLAGS main.c++ -o bench
+echo "[BUILD]: Build succeeded!"
+
+if [ "$1" = "run" ]; then
+    shift
+    ./bench "$@"
+fi
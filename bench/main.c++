@@ -0,0 +1,814 @@
+// Headless microbenchmarks for the software rasterizer.
+//
+//   bench [--csv | --json] [--out file] [--filter text] [--time seconds]
+//
+// Every case reports ns per call and pixels touched per second, so results
+// from different sizes (and different commits) can be compared directly.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "../src/ver3/winhelp.hpp"
+#include "../3dtest/render3d/render3d.hpp"
+using namespace winhelp;
+
+struct Result {
+    std::string name;
+    std::string params;
+    long long iterations;
+    double nsPerOp;
+    double pixelsPerOp;
+};
+
+struct Options {
+    bool json = false;
+    std::string out;
+    std::string filter;
+    double seconds = 0.2;
+};
+
+static Options options;
+static std::vector<Result> results;
+static volatile uint32_t sink; // keeps the optimiser from dropping the work
+
+static void run(const std::string& name, const std::string& params,
+                double pixelsPerOp, const std::function<void()>& op,
+                const Surface& touched) {
+
+    std::string full = name + " " + params;
+    if (!options.filter.empty() && full.find(options.filter) == std::string::npos)
+        return;
+
+    using clock = std::chrono::steady_clock;
+
+    op(); // warm up caches and page in the target
+
+    // grow the batch until it takes long enough to time reliably
+    long long iterations = 1;
+    double elapsed = 0;
+    while (true) {
+        auto start = clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            op();
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        if (elapsed >= options.seconds || iterations >= (1ll << 40))
+            break;
+
+        iterations *= elapsed > 0 ? std::max(2ll, (long long)(options.seconds / elapsed)) : 100;
+    }
+
+    if (!touched.pixels.empty())
+        sink = touched.pixels[touched.pixels.size() / 2];
+
+    results.push_back({ name, params, iterations, elapsed * 1e9 / iterations, pixelsPerOp });
+
+    fprintf(stderr, "%-14s %-26s %12.1f ns/op %10.1f Mpx/s\n",
+            name.c_str(), params.c_str(),
+            results.back().nsPerOp,
+            pixelsPerOp / results.back().nsPerOp * 1e3);
+}
+
+static std::string dims(int w, int h) {
+    return std::to_string(w) + "x" + std::to_string(h);
+}
+
+static Surface make_sprite(int w, int h, bool translucent) {
+    Surface s({ (float)w, (float)h });
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            uint32_t a = translucent ? (uint32_t)((x + y) * 255 / std::max(1, w + h - 2)) : 255;
+            s.pixels[(size_t)y * w + x] = (a << 24) | ((x * 7 & 0xFF) << 16) | ((y * 13 & 0xFF) << 8) | 0x40;
+        }
+    }
+    s.hasAlpha = translucent;
+    return s;
+}
+
+static void bench_fill() {
+    for (int size : { 64, 256, 1024 }) {
+        Surface target({ (float)size, (float)size });
+        run("fill", dims(size, size), (double)size * size,
+            [&] { target.fill(vec3(20, 20, 30)); }, target);
+    }
+
+    Surface hd({ 1920, 1080 });
+    run("fill", dims(1920, 1080), 1920.0 * 1080,
+        [&] { hd.fill(vec3(20, 20, 30)); }, hd);
+}
+
+// a width that isn't a multiple of 16, packed rows vs rows on 64 byte lines
+static void bench_pitch() {
+    for (int pitch : { 0, Surface::alignedPitch(1000) }) {
+        Surface target({ 1000, 1000 }, pitch);
+        std::string params = pitch ? "aligned" : "packed";
+
+        run("rect_filled", "1000x1000 " + params, 1e6,
+            [&] { draw::rect(target, { 0, 0 }, { 1000, 1000 }, { 200, 40, 40 }); }, target);
+        run("rect_filled", "61x61 " + params, 61.0 * 61,
+            [&] { draw::rect(target, { 13, 13 }, { 61, 61 }, { 200, 40, 40 }); }, target);
+
+        Surface sprite = make_sprite(600, 600, false);
+        run("blit_opaque", "600x600 " + params, 600.0 * 600,
+            [&] { target.blit({ 3, 3 }, sprite); }, target);
+    }
+}
+
+static void bench_blit() {
+    Surface target({ 1920, 1080 });
+
+    for (bool translucent : { false, true }) {
+        for (int size : { 16, 64, 256, 1024 }) {
+            Surface sprite = make_sprite(size, size, translucent);
+            run(translucent ? "blit_blend" : "blit_opaque", dims(size, size), (double)size * size,
+                [&] { target.blit({ 100, 20 }, sprite); }, target);
+        }
+    }
+}
+
+// each filter growing and shrinking a 512x512 sprite, against a same size
+// blit; rates are target pixels
+static void bench_scaled() {
+    Surface target({ 1920, 1080 });
+    Surface sprite = make_sprite(512, 512, false);
+    Surface translucent = make_sprite(512, 512, true);
+
+    run("blit_scaled", "512->512 (blit)", 512.0 * 512,
+        [&] { draw::blit_scaled(target, sprite, { 8, 8 }, { 512, 512 }); }, target);
+
+    const std::pair<const char*, draw::filter> filters[] = {
+        { "nearest", draw::filter::nearest }, { "bilinear", draw::filter::bilinear }, { "box", draw::filter::box }
+    };
+
+    for (auto& [name, sampling] : filters) {
+        for (int size : { 128, 384, 1024 }) {
+            run(std::string("blit_scaled_") + name, "512->" + std::to_string(size), (double)size * size,
+                [&] { draw::blit_scaled(target, sprite, { 8, 8 }, { (float)size, (float)size }, sampling); }, target);
+        }
+        run(std::string("blit_scaled_") + name, "512->384 alpha", 384.0 * 384,
+            [&] { draw::blit_scaled(target, translucent, { 8, 8 }, { 384, 384 }, sampling); }, target);
+    }
+}
+
+// a 256x256 sprite turned 30 degrees, at 1x and 2x; rates are source pixels
+// so they line up with the blit_opaque/blit_blend 256x256 cases
+static void bench_transformed() {
+    Surface target({ 1920, 1080 });
+
+    for (bool translucent : { false, true }) {
+        Surface sprite = make_sprite(256, 256, translucent);
+
+        for (float scale : { 1.0f, 2.0f }) {
+            mat2x3 m = mat2x3::translate({ 600, 500 }) * mat2x3::rotate(0.52f) *
+                mat2x3::scale({ scale, scale }) * mat2x3::translate({ -128, -128 });
+            std::string params = std::string(translucent ? "alpha" : "opaque") + " x" + std::to_string((int)scale);
+
+            run("blit_rotated_nearest", params, 256.0 * 256 * scale * scale,
+                [&] { draw::blit_transformed(target, sprite, m, draw::filter::nearest); }, target);
+            run("blit_rotated_bilinear", params, 256.0 * 256 * scale * scale,
+                [&] { draw::blit_transformed(target, sprite, m, draw::filter::bilinear); }, target);
+        }
+    }
+}
+
+// a ring: clear middle and outside, solid band, soft edges (text, icons)
+static Surface make_ring(int size) {
+    Surface s({ (float)size, (float)size });
+    float c = size * 0.5f;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float d = std::fabs(std::hypot(x + 0.5f - c, y + 0.5f - c) - size * 0.35f);
+            float a = std::clamp((size * 0.08f - d) * 64, 0.0f, 255.0f);
+            s.row(y)[x] = ((uint32_t)a << 24) | ((x * 7 & 0xFF) << 16) | 0x40C0;
+        }
+    }
+    s.hasAlpha = true;
+    return s;
+}
+
+// sparse sprites blitted as a Surface and as an RleSurface; params carry
+// the bytes each one takes
+static void bench_rle() {
+    Surface target({ 1920, 1080 });
+
+    for (int size : { 64, 256 }) {
+        Surface ring = make_ring(size);
+        RleSurface compiled(ring);
+
+        run("blit_sparse", dims(size, size) + " bytes=" + std::to_string(ring.pixels.size() * 4), (double)size * size,
+            [&] { target.blit({ 100, 20 }, ring); }, target);
+        run("blit_rle", dims(size, size) + " bytes=" + std::to_string(compiled.bytes()), (double)size * size,
+            [&] { draw::blit(target, compiled, { 100, 20 }); }, target);
+    }
+
+    Surface gradient = make_sprite(256, 256, true);
+    RleSurface dense(gradient);
+    run("blit_rle", "256x256 all translucent bytes=" + std::to_string(dense.bytes()), 256.0 * 256,
+        [&] { draw::blit(target, dense, { 100, 20 }); }, target);
+}
+
+// the same ring as coverage only, tinted at draw time, against blitting
+// its ARGB version (which has the colour baked in)
+static void bench_mask() {
+    Surface target({ 1920, 1080 });
+
+    for (int size : { 64, 256 }) {
+        Surface ring = make_ring(size);
+        MaskSurface mask({ (float)size, (float)size });
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                mask.row(y)[x] = (uint8_t)(ring.row(y)[x] >> 24);
+
+        run("blit_argb_glyph", dims(size, size) + " bytes=" + std::to_string(ring.pixels.size() * 4), (double)size * size,
+            [&] { target.blit({ 100, 20 }, ring); }, target);
+        run("blit_mask", dims(size, size) + " bytes=" + std::to_string(mask.pixels.size()), (double)size * size,
+            [&] { draw::blit_mask(target, mask, { 100, 20 }, vec4(255, 200, 40, 255)); }, target);
+    }
+}
+
+// full screen light/glow passes, each mode against plain alpha
+static void bench_blend() {
+    Surface target({ 1920, 1080 });
+    Surface light = make_sprite(1920, 1080, true);
+    Surface opaque = make_sprite(1920, 1080, false);
+
+    const std::pair<const char*, blend_mode> modes[] = {
+        { "alpha", blend_mode::alpha }, { "add", blend_mode::add },
+        { "multiply", blend_mode::multiply }, { "screen", blend_mode::screen },
+        { "min", blend_mode::min }, { "max", blend_mode::max }
+    };
+
+    for (auto& [name, mode] : modes) {
+        run(std::string("blend_") + name, "1920x1080 alpha", 1920.0 * 1080,
+            [&] { target.blit({ 0, 0 }, light, mode); }, target);
+        run(std::string("blend_") + name, "1920x1080 opacity=128", 1920.0 * 1080,
+            [&] { target.blit({ 0, 0 }, opaque, mode, 128); }, target);
+    }
+}
+
+static void bench_line() {
+    Surface target({ 1024, 1024 });
+
+    for (float thickness : { 1.0f, 2.0f, 4.0f, 8.0f, 20.0f }) {
+        // 45 degree and shallow lines, covered area ~ length * thickness
+        double length = std::hypot(800.0, 800.0) + std::hypot(800.0, 200.0);
+        run("line", "len=" + std::to_string((int)length) + " t=" + std::to_string((int)thickness),
+            length * thickness,
+            [&] {
+                draw::line(target, { 100, 100 }, { 900, 900 }, { 255, 200, 0 }, thickness);
+                draw::line(target, { 100, 500 }, { 900, 700 }, { 0, 200, 255 }, thickness);
+            }, target);
+    }
+
+    for (float thickness : { 1.0f, 4.0f, 20.0f }) {
+        double length = std::hypot(800.0, 800.0) + std::hypot(800.0, 200.0);
+        run("line_aa", "len=" + std::to_string((int)length) + " t=" + std::to_string((int)thickness),
+            length * thickness,
+            [&] {
+                draw::line_aa(target, { 100, 100 }, { 900, 900 }, { 255, 200, 0 }, thickness, draw::cap::round);
+                draw::line_aa(target, { 100, 500 }, { 900, 700 }, { 0, 200, 255 }, thickness, draw::cap::round);
+            }, target);
+    }
+}
+
+static void bench_polyline() {
+    Surface target({ 1920, 1080 });
+
+    // a graph series, one point per ~0.02 px
+    for (int count : { 1000, 100000 }) {
+        std::vector<vec2> series;
+        for (int i = 0; i < count; ++i) {
+            float x = i * 1900.0f / count + 10;
+            series.push_back({ x, 540 + std::sin(i * 0.05f) * 300 + std::sin(i * 0.37f) * 40 });
+        }
+
+        run("polyline", "points=" + std::to_string(count) + " t=1", (double)count,
+            [&] { draw::polyline(target, series, { 255, 255, 255 }); }, target);
+
+        run("line_loop", "points=" + std::to_string(count) + " t=1", (double)count,
+            [&] {
+                for (int i = 0; i + 1 < count; ++i)
+                    draw::line(target, series[i], series[i + 1], { 255, 255, 255 });
+            }, target);
+
+        run("polyline", "points=" + std::to_string(count) + " t=4", (double)count * 4,
+            [&] { draw::polyline(target, series, { 255, 255, 255 }, 4, false, draw::join::round); }, target);
+    }
+}
+
+static void bench_rect() {
+    Surface target({ 1024, 1024 });
+
+    for (int size : { 8, 64, 256, 1000 }) {
+        run("rect_filled", dims(size, size), (double)size * size,
+            [&] { draw::rect(target, { 10, 10 }, { (float)size, (float)size }, { 200, 40, 40 }); }, target);
+    }
+
+    for (int size : { 64, 256, 1000 }) {
+        run("rect_outline", dims(size, size), 4.0 * size,
+            [&] { draw::rect(target, { 10, 10 }, { (float)size, (float)size }, { 200, 40, 40 }, false); }, target);
+    }
+}
+
+static void bench_circle() {
+    Surface target({ 1024, 1024 });
+
+    for (int radius : { 4, 32, 128, 500 }) {
+        run("circle_filled", "r=" + std::to_string(radius), 3.14159265 * radius * radius,
+            [&] { draw::circle(target, { 512, 512 }, radius, { 40, 200, 40 }); }, target);
+    }
+
+    for (int radius : { 4, 32, 128, 500 }) {
+        run("circle_outline", "r=" + std::to_string(radius), 2 * 3.14159265 * radius,
+            [&] { draw::circle(target, { 512, 512 }, radius, { 40, 200, 40 }, false); }, target);
+    }
+
+    // particles: lots of small circles sharing a few radii, the cached case
+    run("circle_many", "n=1000 r=2..9", 1000 * 3.14159265 * 30,
+        [&] {
+            for (int i = 0; i < 1000; ++i)
+                draw::circle(target, { (float)(i * 37 % 1000 + 12), (float)(i * 91 % 1000 + 12) }, 2 + i % 8, { 255, 255, 255 });
+        }, target);
+
+    for (int radius : { 8, 128 }) {
+        run("circle_aa", "r=" + std::to_string(radius), 3.14159265 * radius * radius,
+            [&] { draw::circle_aa(target, { 512.5f, 512.5f }, (float)radius, { 40, 200, 40 }); }, target);
+        run("ring_aa", "r=" + std::to_string(radius) + " t=2", 2 * 3.14159265 * radius * 2,
+            [&] { draw::circle_aa(target, { 512.5f, 512.5f }, (float)radius, { 40, 200, 40 }, false, 2); }, target);
+    }
+
+    run("ellipse", "r=300x120", 3.14159265 * 300 * 120,
+        [&] { draw::ellipse(target, { 512, 512 }, { 300, 120 }, { 40, 200, 40 }); }, target);
+    run("ellipse_aa", "r=300x120", 3.14159265 * 300 * 120,
+        [&] { draw::ellipse_aa(target, { 512, 512 }, { 300, 120 }, { 40, 200, 40 }); }, target);
+    run("pie", "r=200 270deg", 3.14159265 * 200 * 200 * 0.75,
+        [&] { draw::pie(target, { 512, 512 }, 200, 0, 4.712f, { 40, 200, 40 }); }, target);
+    run("arc", "r=200 t=4", 3.14159265 * 200 * 4 * 0.75,
+        [&] { draw::arc(target, { 512, 512 }, 200, 0, 4.712f, { 40, 200, 40 }, 4); }, target);
+}
+
+// a UI pane drawn into part of the frame: through a view, or the old way
+// of drawing into a separate Surface and blitting it over
+static void bench_view() {
+    Surface target({ 1920, 1080 });
+
+    for (int size : { 64, 256, 512 }) {
+        auto pane = [&](SurfaceView v) {
+            v.fill(0xFF303040);
+            draw::rect(v, { 4, 4 }, { (float)size - 8, 20 }, { 80, 80, 120 });
+            draw::circle(v, { size * 0.5f, size * 0.5f }, size / 4, { 200, 160, 40 });
+        };
+
+        run("pane_view", dims(size, size), (double)size * size,
+            [&] { pane(target.view({ 300, 200 }, { (float)size, (float)size })); }, target);
+
+        run("pane_surface", dims(size, size), (double)size * size,
+            [&] {
+                Surface temp({ (float)size, (float)size });
+                pane(temp);
+                target.blit({ 300, 200 }, temp);
+            }, target);
+    }
+}
+
+// a temporary surface per call (Font::render style), served by the pool
+// and with pooling turned off
+static void bench_pool() {
+    for (int size : { 64, 512 }) {
+        for (bool pooled : { true, false }) {
+            pool::set_budget(pooled ? (size_t)64 << 20 : 0);
+            run("surface_temp", dims(size, size) + (pooled ? " pooled" : " heap"), (double)size * size,
+                [&] {
+                    Surface temp({ (float)size, (float)size });
+                    sink = temp.pixels[0];
+                }, Surface());
+        }
+    }
+    pool::set_budget((size_t)64 << 20);
+}
+
+// a frame's worth of small instances scattered over a 1080p target,
+// drawn one call each and then as a single batch
+static void bench_batch() {
+    Surface target({ 1920, 1080 });
+
+    for (int count : { 1000, 100000, 1000000 }) {
+        draw::RectBatch rects;
+        draw::CircleBatch circles;
+        rects.reserve(count);
+        circles.reserve(count);
+
+        uint32_t seed = 1;
+        auto next = [&](int range) {
+            seed = seed * 1103515245u + 12345u;
+            return (int)((seed >> 8) % (uint32_t)range);
+        };
+
+        double rectPixels = 0, circlePixels = 0;
+        for (int i = 0; i < count; ++i) {
+            vec2 pos = { (float)next(1920), (float)next(1080) };
+            vec2 size = { (float)(2 + next(7)), (float)(2 + next(7)) };
+            vec3 colour = { (float)next(256), (float)next(256), (float)next(256) };
+            int radius = 1 + next(5);
+
+            rects.add(pos, size, colour);
+            circles.add(pos, radius, colour);
+            rectPixels += size.x * size.y;
+            circlePixels += 3.14159265 * radius * radius;
+        }
+
+        std::string params = "n=" + std::to_string(count);
+
+        run("rect_loop", params, rectPixels,
+            [&] {
+                for (int i = 0; i < count; ++i)
+                    draw::rect(target, { rects.x[i], rects.y[i] }, { rects.w[i], rects.h[i] },
+                               vec3((float)(rects.colour[i] >> 16 & 0xFF), (float)(rects.colour[i] >> 8 & 0xFF), (float)(rects.colour[i] & 0xFF)));
+            }, target);
+        run("rects", params, rectPixels, [&] { draw::rects(target, rects); }, target);
+
+        run("circle_loop", params, circlePixels,
+            [&] {
+                for (int i = 0; i < count; ++i)
+                    draw::circle(target, { circles.x[i], circles.y[i] }, circles.radius[i],
+                                 vec3((float)(circles.colour[i] >> 16 & 0xFF), (float)(circles.colour[i] >> 8 & 0xFF), (float)(circles.colour[i] & 0xFF)));
+            }, target);
+        run("circles", params, circlePixels, [&] { draw::circles(target, circles); }, target);
+    }
+}
+
+#ifdef _WIN32
+static void bench_font() {
+    Font font(32);
+    Surface target({ 1920, 1080 });
+
+    for (int length : { 8, 32, 128 }) {
+        std::string text;
+        for (int i = 0; i < length; ++i)
+            text += (char)('a' + i % 26);
+
+        ivec2 size = font.sizeOf(text);
+        run("font_render", "chars=" + std::to_string(length), (double)size.x * size.y,
+            [&] { target.blit({ 10, 10 }, font.render(text, { 255, 255, 255 }, { 0, 0, 0, 0 })); }, target);
+        run("font_draw", "chars=" + std::to_string(length), (double)size.x * size.y,
+            [&] { font.draw(target, { 10, 10 }, text, vec4(255, 255, 255, 255)); }, target);
+        run("font_atlas_draw", "chars=" + std::to_string(length) + " (glyphs/s)", (double)length,
+            [&] { font.glyphs().draw(target, { 10, 10 }, text, vec4(255, 255, 255, 255)); }, target);
+    }
+}
+#endif
+
+// 12x16 glyphs with a diagonal through them, stands in for a real font so the
+// atlas can be timed anywhere; rates are glyphs
+static void bench_atlas() {
+    GlyphAtlas atlas;
+    atlas.lineHeight = 16;
+    atlas.rasterize = [](uint32_t c, GlyphAtlas::Bitmap& out) {
+        out.coverage = MaskSurface({ 12, 16 });
+        for (int y = 0; y < 16; ++y)
+            for (int x = 0; x < 12; ++x)
+                out.coverage.row(y)[x] = (uint8_t)(((x + y + c) % 3) ? 0 : 255);
+        out.advance = 13;
+        return true;
+    };
+
+    Surface target({ 1920, 1080 });
+
+    for (int length : { 8, 32, 128 }) {
+        std::string text;
+        for (int i = 0; i < length; ++i)
+            text += (char)('a' + i % 26);
+
+        run("atlas_draw", "chars=" + std::to_string(length), (double)length,
+            [&] { atlas.draw(target, { 10, 10 }, text, vec4(255, 255, 255, 255)); }, target);
+        run("atlas_measure", "chars=" + std::to_string(length), (double)length,
+            [&] { volatile int w = atlas.measure(text).x; (void)w; }, target);
+    }
+}
+
+// a real outline font, DejaVu Sans unless WINHELP_BENCH_FONT says otherwise;
+// skipped without one. Rates are glyphs: truetype_raster straight from the
+// outlines every time, truetype_draw out of the font's atlas, sdf_* the
+// distance fields drawScaled uses.
+static void bench_truetype() {
+    const char* env = std::getenv("WINHELP_BENCH_FONT");
+    std::string path = env ? env : "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
+
+    TrueType face(path);
+    if (!face.ok()) {
+        fprintf(stderr, "truetype: no font at %s, skipped\n", path.c_str());
+        return;
+    }
+
+    std::vector<int> glyphs;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        glyphs.push_back(face.glyphIndex(c));
+        glyphs.push_back(face.glyphIndex(c - 'a' + 'A'));
+    }
+
+    Surface none;
+    for (int size : { 12, 32, 96 }) {
+        float scale = (float)size / face.unitsPerEm;
+        MaskSurface out;
+        ivec2 offset;
+        run("truetype_raster", "px=" + std::to_string(size) + " (glyphs/s)", (double)glyphs.size(),
+            [&] { for (int g : glyphs) face.rasterize(g, scale, out, offset); }, none);
+    }
+
+    Font font(path, 16);
+    Surface target({ 1920, 1080 });
+    for (int length : { 8, 32, 128 }) {
+        std::string text;
+        for (int i = 0; i < length; ++i)
+            text += (char)('a' + i % 26);
+
+        run("truetype_draw", "chars=" + std::to_string(length) + " (glyphs/s)", (double)length,
+            [&] { font.glyphs().draw(target, { 10, 10 }, text, vec4(255, 255, 255, 255)); }, target);
+    }
+
+    // a HUD label every frame: laid out and rasterized again, or out of a TextCache
+    TextCache cache;
+    std::string label = "Press (Space) to shuffle sequence";
+    ivec2 labelSize = font.sizeOf(label);
+    run("text_render", "chars=" + std::to_string(label.size()), (double)labelSize.x * labelSize.y,
+        [&] { draw::blit_mask(target, font.renderMask(label), { 10, 10 }, vec4(255, 255, 255, 255)); }, target);
+    run("text_cache", "chars=" + std::to_string(label.size()), (double)labelSize.x * labelSize.y,
+        [&] { cache.draw(target, font, { 10, 10 }, label, vec4(255, 255, 255, 255)); }, target);
+    run("text_draw", "chars=" + std::to_string(label.size()), (double)labelSize.x * labelSize.y,
+        [&] { font.draw(target, { 10, 10 }, label, vec4(255, 255, 255, 255)); }, target);
+
+    // a few lines through a surface of their own and a blit, against straight into the target
+    std::string paragraph;
+    for (int i = 0; i < 8; ++i)
+        paragraph += "Every text draw used to go through a surface\n";
+    ivec2 paragraphSize = font.renderMask(paragraph).size;
+    run("text_render", "lines=9 (surface + blit)", (double)paragraphSize.x * paragraphSize.y,
+        [&] { target.blit({ 10, 10 }, font.render(paragraph, { 255, 255, 255 }, { 0, 0, 0, 0 })); }, target);
+    run("text_draw", "lines=9", (double)paragraphSize.x * paragraphSize.y,
+        [&] { font.draw(target, { 10, 10 }, paragraph, vec4(255, 255, 255, 255)); }, target);
+
+    // a 20000 line console: laying all of it out, against appending a line and
+    // drawing the panel (rates are lines of the console)
+    std::string log;
+    for (int i = 0; i < 20000; ++i)
+        log += "[" + std::to_string(i) + "] something happened and it was logged here\n";
+
+    TextLayout console(font, 400);
+    run("layout_full", "lines=20000", 20000.0, [&] { console.setText(log); console.lineCount(); }, none);
+
+    SurfaceView panel = target.view({ 10, 10 }, { 400, 600 });
+    run("layout_append", "lines=20000", 20000.0, [&] {
+        console.append("one more line\n");
+        console.draw(panel, { 0, 600.0f - console.size().y }, vec4(255, 255, 255, 255));
+    }, target);
+
+    // distance fields: making one per glyph (once per font), then drawing from them at any size
+    MaskSurface field;
+    ivec2 offset;
+    run("sdf_field", "px=48 (glyphs/s)", (double)glyphs.size(),
+        [&] { for (int g : glyphs) face.distanceField(g, 48.0f / face.unitsPerEm, 6, field, offset); }, none);
+
+    std::string text = "the quick brown fox jumps over the lazy dog";
+    for (float size : { 12.0f, 48.0f, 160.0f })
+        run("sdf_draw", "px=" + std::to_string((int)size) + " (glyphs/s)", (double)text.size(),
+            [&] { font.drawScaled(target, { 10, 10 }, text, size, vec4(255, 255, 255, 255)); }, target);
+}
+
+// decoding alone, rates are bytes: all ASCII (the SSE2 skip) against text
+// where every few characters need decoding
+static void bench_utf8() {
+    std::string ascii, mixed;
+    while (ascii.size() < 4096)
+        ascii += "The quick brown fox jumps over the lazy dog. ";
+    while (mixed.size() < 4096)
+        mixed += "Grüße aus Köln, Ωμέγα → Жизнь ☺ ";
+
+    Surface none;
+    for (const std::string* text : { &ascii, &mixed }) {
+        run("utf8_decode", text == &ascii ? "ascii 4K" : "mixed 4K", (double)text->size(), [&] {
+            uint32_t sum = 0;
+            utf8::for_each(*text, [&](uint32_t c, size_t) { sum += c; });
+            sink = sum;
+        }, none);
+    }
+}
+
+static void bench_render3d() {
+    Surface target({ 800, 600 });
+
+    for (int grid : { 1, 4, 8 }) {
+        render3d::Renderer renderer;
+        renderer.cameraPos = { -4.0f, -3.0f, -8.0f };
+
+        // grid x grid cubes spread around the origin
+        for (int gy = 0; gy < grid; ++gy) {
+            for (int gx = 0; gx < grid; ++gx) {
+                render3d::Object cube = render3d::create::cube(0.4f, { 255.0f, 60.0f + gx * 20.0f, 60.0f + gy * 20.0f });
+                vec3 offset = { (gx - grid / 2.0f) * 1.2f, (gy - grid / 2.0f) * 1.2f, 0 };
+                for (auto& face : cube.faces) {
+                    for (auto& p : face.points)
+                        p += offset;
+                    face.recalcAvgZ();
+                }
+                renderer.addObject(cube);
+            }
+        }
+
+        // pixels covered by the scene (ignores overdraw)
+        target.fill(vec3(0, 0, 0));
+        renderer.render(target);
+        double covered = 0;
+        for (uint32_t p : target.pixels)
+            covered += (p != 0xFF000000);
+
+        run("render3d", "cubes=" + std::to_string(grid * grid), covered,
+            [&] { renderer.render(target); }, target);
+    }
+}
+
+// big fills, blits and polygons on one thread against split over the job
+// threads (4 when the machine only has 1, which shows the overhead), and
+// what a job costs on its own
+static void bench_jobs() {
+    Surface target({ 1920, 1080 });
+    Surface sprite = make_sprite(1024, 1024, true);
+
+    std::vector<std::array<vec2, 2>> star;
+    for (int i = 0; i < 5; ++i) {
+        float a = i * 2.513274f, b = (i + 1) * 2.513274f; // every second point of a pentagon
+        star.push_back({ vec2(960 + 520 * std::sin(a), 540 - 520 * std::cos(a)),
+                         vec2(960 + 520 * std::sin(b), 540 - 520 * std::cos(b)) });
+    }
+
+    target.fill(vec3(0, 0, 0));
+    draw::polygon(target, star, vec3(200, 200, 40));
+    double covered = 0;
+    for (uint32_t p : target.pixels)
+        covered += (p != 0xFF000000);
+
+    int hardware = (int)std::thread::hardware_concurrency();
+    for (int threads : { 1, hardware > 1 ? hardware : 4 }) {
+        jobs::set_threads(threads);
+        std::string params = "threads=" + std::to_string(threads);
+
+        run("jobs_fill", dims(1920, 1080) + " " + params, 1920.0 * 1080,
+            [&] { target.fill(vec3(20, 20, 30)); }, target);
+        run("jobs_blit", "1024x1024 blend " + params, 1024.0 * 1024,
+            [&] { target.blit({ 100, 20 }, sprite); }, target);
+        run("jobs_polygon", "star r=520 " + params, covered,
+            [&] { draw::polygon(target, star, vec3(200, 200, 40)); }, target);
+
+        // rates are jobs
+        run("jobs_for", "64 empty pieces " + params, 64,
+            [&] { jobs::parallel_for(0, 64, 1, [](int, int) {}); }, target);
+
+        jobs::Graph graph;
+        size_t root = graph.add([] {});
+        for (int i = 0; i < 63; ++i)
+            graph.add([] {}, { root });
+        run("jobs_graph", "1 then 63 empty jobs " + params, 64,
+            [&] { graph.run(); }, target);
+    }
+
+    jobs::set_threads(0);
+}
+
+// a frame of everything (background, 2000 rects, 500 circles, 300 lines,
+// sprites and labels) drawn straight away, recorded and submitted, or just
+// submitted again; rates are target pixels
+static void bench_commands() {
+    Surface target({ 1920, 1080 });
+    Surface sprite = make_sprite(64, 64, true);
+
+    const char* env = std::getenv("WINHELP_BENCH_FONT");
+    Font font(env ? env : "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 14);
+
+    uint32_t seed = 7;
+    auto random = [&](float range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1 << 24) * range;
+    };
+
+    struct Item { vec2 a, b; vec3 colour; };
+    std::vector<Item> rects, circles, lines, sprites, labels;
+    for (int i = 0; i < 2000; ++i) rects.push_back({ { random(1900), random(1060) }, { 4 + random(60), 4 + random(60) }, { random(255), random(255), random(255) } });
+    for (int i = 0; i < 500; ++i) circles.push_back({ { random(1920), random(1080) }, { 2 + random(30), 0 }, { random(255), random(255), random(255) } });
+    for (int i = 0; i < 300; ++i) lines.push_back({ { random(1920), random(1080) }, { random(1920), random(1080) }, { random(255), random(255), random(255) } });
+    for (int i = 0; i < 200; ++i) sprites.push_back({ { random(1900), random(1060) }, {}, {} });
+    for (int i = 0; i < 50; ++i) labels.push_back({ { random(1800), random(1060) }, {}, { random(255), random(255), random(255) } });
+
+    auto immediate = [&] {
+        target.fill(vec3(20, 20, 30));
+        for (auto& r : rects) draw::rect(target, r.a, r.b, r.colour);
+        for (auto& c : circles) draw::circle(target, c.a, (int)c.b.x, c.colour);
+        for (auto& l : lines) draw::line(target, l.a, l.b, l.colour);
+        for (auto& s : sprites) target.blit(s.a, sprite);
+        if (font.ok())
+            for (auto& l : labels) font.draw(target, l.a, "score 12345", vec4(l.colour.x, l.colour.y, l.colour.z, 255));
+    };
+
+    draw::CommandBuffer commands;
+    auto record = [&] {
+        commands.clear();
+        commands.fill(vec3(20, 20, 30));
+        for (auto& r : rects) commands.rect(r.a, r.b, r.colour);
+        for (auto& c : circles) commands.circle(c.a, (int)c.b.x, c.colour);
+        for (auto& l : lines) commands.line(l.a, l.b, l.colour);
+        for (auto& s : sprites) commands.blit(sprite, s.a);
+        if (font.ok())
+            for (auto& l : labels) commands.text(font, l.a, "score 12345", vec4(l.colour.x, l.colour.y, l.colour.z, 255));
+    };
+
+    int hardware = (int)std::thread::hardware_concurrency();
+    for (int threads : { 1, hardware > 1 ? hardware : 4 }) {
+        jobs::set_threads(threads);
+        std::string params = "frame threads=" + std::to_string(threads);
+
+        run("commands_immediate", params, 1920.0 * 1080, immediate, target);
+        run("commands_record", params, 1920.0 * 1080, [&] { record(); commands.submit(target); }, target);
+        record();
+        run("commands_replay", params, 1920.0 * 1080, [&] { commands.submit(target); }, target);
+    }
+
+    jobs::set_threads(0);
+}
+
+static void write_results(FILE* f) {
+    if (options.json) {
+        fprintf(f, "[\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            fprintf(f,
+                "  {\"name\": \"%s\", \"params\": \"%s\", \"iterations\": %lld, "
+                "\"ns_per_op\": %.3f, \"pixels_per_op\": %.1f, \"pixels_per_s\": %.1f}%s\n",
+                r.name.c_str(), r.params.c_str(), r.iterations,
+                r.nsPerOp, r.pixelsPerOp, r.pixelsPerOp / r.nsPerOp * 1e9,
+                i + 1 < results.size() ? "," : "");
+        }
+        fprintf(f, "]\n");
+        return;
+    }
+
+    fprintf(f, "name,params,iterations,ns_per_op,pixels_per_op,pixels_per_s\n");
+    for (const Result& r : results) {
+        fprintf(f, "%s,%s,%lld,%.3f,%.1f,%.1f\n",
+                r.name.c_str(), r.params.c_str(), r.iterations,
+                r.nsPerOp, r.pixelsPerOp, r.pixelsPerOp / r.nsPerOp * 1e9);
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") options.json = true;
+        else if (arg == "--csv") options.json = false;
+        else if (arg == "--out" && i + 1 < argc) options.out = argv[++i];
+        else if (arg == "--filter" && i + 1 < argc) options.filter = argv[++i];
+        else if (arg == "--time" && i + 1 < argc) options.seconds = std::atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--csv | --json] [--out file] [--filter text] [--time seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_fill();
+    bench_pitch();
+    bench_blit();
+    bench_blend();
+    bench_scaled();
+    bench_transformed();
+    bench_rle();
+    bench_mask();
+    bench_line();
+    bench_polyline();
+    bench_rect();
+    bench_circle();
+    bench_batch();
+    bench_view();
+    bench_pool();
+    bench_jobs();
+    bench_commands();
+#ifdef _WIN32
+    bench_font();
+#endif
+    bench_atlas();
+    bench_truetype();
+    bench_utf8();
+    bench_render3d();
+
+    FILE* f = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "could not open %s\n", options.out.c_str());
+        return 1;
+    }
+
+    write_results(f);
+    if (f != stdout)
+        fclose(f);
+
+    return 0;
+}
@@ -1,6 +1,10 @@
 #pragma once
+// Everything except display, GDI fonts and the window proc is plain C++, so
+// Surface and draw:: also build headless (benchmarks, tests) off Windows.
+#ifdef _WIN32
 #include <windows.h>
 #include <windowsx.h>
+#endif
 
 #include <vector>
 #include <array>
@@ -8,19 +12,198 @@
 #include <cstdint>
 #include <algorithm>
 #include <cmath>
-#include <format>
 #include <chrono>
 #include <thread>
 #include <cstring>
 #include <stdexcept>
-
+#include <new>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <list>
+#include <string_view>
+#include <fstream>
+#include <iterator>
+
+#if __has_include(<format>)
 #include <format>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define WINHELP_SSE2 1
+#endif
 
 #include <stdint.h>
 
+#ifdef WINHELP_PROFILE
+#include <cstdio>
+#endif
+
+
+// Profiling: define WINHELP_PROFILE before including this header to record
+// WINHELP_PROFILE_SCOPE("name") blocks, otherwise the macro compiles to nothing.
+#ifdef WINHELP_PROFILE
+
+namespace winhelp::profile {
+    using clock = std::chrono::steady_clock;
+
+    struct Sample {
+        const char* name; // must outlive the trace, string literals only
+        int64_t start;    // ns since epoch()
+        int64_t end;
+    };
+
+    // One buffer per thread, only that thread writes to it.
+    // Buffers are never freed so a trace can be exported after the thread exits.
+    struct ThreadBuffer {
+        static constexpr size_t capacity = 1 << 16;
+
+        Sample samples[capacity];
+        std::atomic<size_t> count{ 0 };
+        std::atomic<size_t> dropped{ 0 };
+        uint32_t threadId = 0;
+        ThreadBuffer* next = nullptr;
+    };
+
+    inline clock::time_point epoch() {
+        static const clock::time_point t = clock::now();
+        return t;
+    }
+
+    inline int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - epoch()).count();
+    }
+
+    inline std::atomic<ThreadBuffer*>& buffers() {
+        static std::atomic<ThreadBuffer*> head{ nullptr };
+        return head;
+    }
+
+    inline ThreadBuffer& thread_buffer() {
+        thread_local ThreadBuffer* buffer = [] {
+            static std::atomic<uint32_t> nextId{ 1 };
+
+            ThreadBuffer* b = new ThreadBuffer();
+            b->threadId = nextId.fetch_add(1, std::memory_order_relaxed);
+
+            // lock free push onto the global list
+            b->next = buffers().load(std::memory_order_relaxed);
+            while (!buffers().compare_exchange_weak(
+                b->next, b,
+                std::memory_order_release,
+                std::memory_order_relaxed)) {}
+
+            return b;
+        }();
+        return *buffer;
+    }
+
+    inline void record(const char* name, int64_t start, int64_t end) {
+        ThreadBuffer& b = thread_buffer();
+        size_t i = b.count.load(std::memory_order_relaxed);
+
+        if (i >= ThreadBuffer::capacity) {
+            b.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        b.samples[i] = { name, start, end };
+        b.count.store(i + 1, std::memory_order_release);
+    }
+
+    struct Scope {
+        const char* name;
+        int64_t start;
+
+        Scope(const char* scopeName) : name(scopeName), start(now()) {}
+        ~Scope() { record(name, start, now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Throws away everything recorded so far, call between frames
+    // while no other thread is inside a scope.
+    inline void reset() {
+        for (ThreadBuffer* b = buffers().load(std::memory_order_acquire); b; b = b->next) {
+            b->count.store(0, std::memory_order_release);
+            b->dropped.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    inline size_t dropped() {
+        size_t total = 0;
+        for (ThreadBuffer* b = buffers().load(std::memory_order_acquire); b; b = b->next)
+            total += b->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Chrome / Perfetto "traceEvents" JSON, open in chrome://tracing or ui.perfetto.dev
+    inline std::string chrome_trace() {
+        std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+
+        for (ThreadBuffer* b = buffers().load(std::memory_order_acquire); b; b = b->next) {
+            size_t count = b->count.load(std::memory_order_acquire);
+
+            for (size_t i = 0; i < count; ++i) {
+                const Sample& s = b->samples[i];
+
+                if (!first) out += ',';
+                first = false;
+
+                out += "{\"name\":\"";
+                for (const char* c = s.name; *c; ++c) {
+                    if (*c == '"' || *c == '\\') out += '\\';
+                    out += *c;
+                }
+
+                char timing[128];
+                snprintf(timing, sizeof(timing),
+                    "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    b->threadId,
+                    s.start / 1000.0,
+                    (s.end - s.start) / 1000.0);
+                out += timing;
+            }
+        }
+
+        out += "]}";
+        return out;
+    }
+
+    inline bool write_chrome_trace(const std::string& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        file << chrome_trace();
+        return (bool)file;
+    }
+}
+
+#define WINHELP_PROFILE_JOIN_(a, b) a##b
+#define WINHELP_PROFILE_JOIN(a, b) WINHELP_PROFILE_JOIN_(a, b)
+#define WINHELP_PROFILE_SCOPE(name) \
+    ::winhelp::profile::Scope WINHELP_PROFILE_JOIN(winhelpProfileScope, __LINE__)(name)
+
+#else
+
+#define WINHELP_PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
 
 namespace winhelp {
+#ifdef _WIN32
     LRESULT CALLBACK wndproc(HWND handle, UINT message, WPARAM wparam, LPARAM lparam);
+#endif
 
     struct VectorDivideByZero : std::exception {
         std::string msg;
@@ -201,724 +384,6100 @@ namespace winhelp {
         }
     };
 
-    inline vec2& internal_mouse() {
-        static vec2 pos;
-        return pos;
-    }
+    // 2D affine transform (rotation, scale, shear, translation) as the top two
+    // rows of a 3x3 matrix:  x' = a * x + b * y + tx,  y' = c * x + d * y + ty
+    struct mat2x3 {
+        float a, b, tx;
+        float c, d, ty;
 
-    inline vec2 mouse() {
-        return internal_mouse();
-    }
+        mat2x3() : a(1), b(0), tx(0), c(0), d(1), ty(0) {}
 
-    struct Surface {
-        ivec2 size;
-        std::vector<uint32_t> pixels;
-        bool hasAlpha = false;
+        mat2x3(float A, float B, float TX, float C, float D, float TY)
+            : a(A), b(B), tx(TX), c(C), d(D), ty(TY) {}
 
-        Surface() : size(0, 0) {}
+        static mat2x3 translate(vec2 offset) {
+            return { 1, 0, offset.x, 0, 1, offset.y };
+        }
 
-        Surface(vec2 surfaceSize)
-            : size(std::max(0, (int)surfaceSize.x), std::max(0, (int)surfaceSize.y)),
-            pixels((size_t)size.x * size.y, 0xFF000000) {}
+        static mat2x3 scale(vec2 factor) {
+            return { factor.x, 0, 0, 0, factor.y, 0 };
+        }
 
-        static uint32_t pack(const vec4& c) {
-            return
-                (uint32_t(c.w) << 24) |
-                (uint32_t(c.x) << 16) |
-                (uint32_t(c.y) << 8)  |
-                uint32_t(c.z);
+        // counter clockwise on screen is negative, y points down
+        static mat2x3 rotate(float radians) {
+            float s = std::sin(radians);
+            float co = std::cos(radians);
+            return { co, -s, 0, s, co, 0 };
         }
 
-        static vec4 unpack(uint32_t v) {
-            return vec4(
-                float((v >> 16) & 0xFF),
-                float((v >> 8)  & 0xFF),
-                float(v & 0xFF),
-                float((v >> 24) & 0xFF)
-            );
+        static mat2x3 shear(vec2 amount) {
+            return { 1, amount.x, 0, amount.y, 1, 0 };
         }
 
-        void fill(vec4 colour) {
-            uint32_t value = pack(colour);
-            uint32_t* ptr = pixels.data();
-            uint32_t* end = ptr + pixels.size();
-            while (ptr < end)
-                *ptr++ = value;
+        // other first, then this
+        mat2x3 operator*(const mat2x3& o) const {
+            return {
+                a * o.a + b * o.c, a * o.b + b * o.d, a * o.tx + b * o.ty + tx,
+                c * o.a + d * o.c, c * o.b + d * o.d, c * o.tx + d * o.ty + ty
+            };
         }
 
-        void blit(vec2 position, const Surface& source, bool blend = true) {
+        vec2 operator*(const vec2& p) const {
+            return { a * p.x + b * p.y + tx, c * p.x + d * p.y + ty };
+        }
 
-            int startX = std::max(0, (int)position.x);
-            int startY = std::max(0, (int)position.y);
+        float determinant() const {
+            return a * d - b * c;
+        }
 
-            int endX = std::min(size.x, (int)position.x + source.size.x);
-            int endY = std::min(size.y, (int)position.y + source.size.y);
+        mat2x3 inverse() const {
+            float det = determinant();
+            if (det == 0) {
+                throw VectorDivideByZero("Tried to invert a mat2x3 that flattens everything onto a line");
+            }
 
-            if (startX >= endX || startY >= endY)
-                return;
+            float ia = d / det, ib = -b / det;
+            float ic = -c / det, id = a / det;
+            return { ia, ib, -(ia * tx + ib * ty), ic, id, -(ic * tx + id * ty) };
+        }
+    };
 
-            int srcOffsetX = startX - (int)position.x;
-            int srcOffsetY = startY - (int)position.y;
+    // Pixel buffers come from a pool of size classes rather than straight from
+    // the heap. A buffer freed by one Surface (Font::render results, temporaries,
+    // a resized display) goes to the next one that needs about the same size, so
+    // a steady state frame doesn't touch the heap for pixels; counters() shows it.
+    // Blocks are 64 byte aligned so rows can start on cache lines.
+    namespace pool {
+        struct Counters {
+            size_t heapAllocations = 0; // buffers that had to come from the heap
+            size_t reused = 0;          // buffers handed out again from the pool
+            size_t released = 0;        // buffers given back to the heap (over budget, trim)
+            size_t bytesCached = 0;     // free bytes held for reuse right now
+        };
 
-            // i am speed
-            if (!blend || !source.hasAlpha) {
+        namespace internal {
+            struct State {
+                std::mutex lock;
+                std::vector<void*> free[256]; // by size class
+                size_t budget = (size_t)64 << 20;
+                Counters counters;
+            };
+
+            // never destroyed, Surfaces with static storage may outlive any static here
+            inline State& state() {
+                static State* s = new State();
+                return *s;
+            }
 
-                for (int y = startY; y < endY; ++y) {
+            // 4 classes per power of two (at most 25% slack), 64 bytes minimum
+            inline int size_class(size_t bytes, size_t& classBytes) {
+                if (bytes <= 64) {
+                    classBytes = 64;
+                    return 0;
+                }
 
-                    uint32_t* dstRow =
-                        &pixels[(size_t)y * size.x + startX];
+                int k = 0;
+                while (((size_t)2 << k) < bytes)
+                    ++k;
+                // 2^k < bytes <= 2^(k + 1), k >= 6
+                size_t step = (size_t)1 << (k - 2);
+                classBytes = (bytes + step - 1) & ~(step - 1);
+                return 1 + (k - 6) * 4 + (int)(classBytes / step - 5);
+            }
+        }
 
-                    const uint32_t* srcRow =
-                        &source.pixels[
-                            (size_t)(y - startY + srcOffsetY) *
-                            source.size.x + srcOffsetX
-                        ];
+        inline void* acquire(size_t bytes) {
+            size_t classBytes;
+            int index = internal::size_class(bytes, classBytes);
+            internal::State& s = internal::state();
 
-                    memcpy(dstRow, srcRow,
-                        (endX - startX) * sizeof(uint32_t));
+            {
+                std::lock_guard<std::mutex> guard(s.lock);
+                if (!s.free[index].empty()) {
+                    void* block = s.free[index].back();
+                    s.free[index].pop_back();
+                    s.counters.bytesCached -= classBytes;
+                    s.counters.reused++;
+                    return block;
                 }
+                s.counters.heapAllocations++;
+            }
 
-                return;
+            return ::operator new(classBytes, std::align_val_t(64));
+        }
+
+        inline void release(void* block, size_t bytes) {
+            size_t classBytes;
+            int index = internal::size_class(bytes, classBytes);
+            internal::State& s = internal::state();
+
+            {
+                std::lock_guard<std::mutex> guard(s.lock);
+                if (s.counters.bytesCached + classBytes <= s.budget) {
+                    s.free[index].push_back(block);
+                    s.counters.bytesCached += classBytes;
+                    return;
+                }
+                s.counters.released++;
             }
 
-            // i am not speed
-            for (int y = startY; y < endY; ++y) {
+            ::operator delete(block, std::align_val_t(64));
+        }
 
-                uint32_t* dstRow =
-                    &pixels[(size_t)y * size.x + startX];
+        inline Counters counters() {
+            internal::State& s = internal::state();
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.counters;
+        }
 
-                const uint32_t* srcRow =
-                    &source.pixels[
-                        (size_t)(y - startY + srcOffsetY) *
-                        source.size.x + srcOffsetX
-                    ];
+        // zero the event counts (bytesCached stays, it's a level not a count)
+        inline void reset_counters() {
+            internal::State& s = internal::state();
+            std::lock_guard<std::mutex> guard(s.lock);
+            s.counters.heapAllocations = 0;
+            s.counters.reused = 0;
+            s.counters.released = 0;
+        }
 
-                for (int x = startX; x < endX; ++x) {
+        // give every cached buffer back to the heap
+        inline void trim() {
+            internal::State& s = internal::state();
+            std::vector<void*> blocks;
+            {
+                std::lock_guard<std::mutex> guard(s.lock);
+                for (auto& list : s.free) {
+                    s.counters.released += list.size();
+                    blocks.insert(blocks.end(), list.begin(), list.end());
+                    list.clear();
+                }
+                s.counters.bytesCached = 0;
+            }
 
-                    uint32_t src = *srcRow++;
-                    uint32_t& dst = *dstRow++;
+            for (void* block : blocks)
+                ::operator delete(block, std::align_val_t(64));
+        }
 
-                    uint32_t srcA = src >> 24;
+        // most bytes kept around for reuse, 0 turns pooling off (64 MB default)
+        inline void set_budget(size_t bytes) {
+            {
+                internal::State& s = internal::state();
+                std::lock_guard<std::mutex> guard(s.lock);
+                s.budget = bytes;
+                if (s.counters.bytesCached <= bytes)
+                    return;
+            }
+            trim();
+        }
 
-                    if (srcA == 255) {
-                        dst = src;
-                        continue;
-                    }
+        template <typename T>
+        struct allocator {
+            using value_type = T;
 
-                    if (srcA == 0)
-                        continue;
+            allocator() noexcept {}
 
-                    uint32_t dstRB = dst & 0x00FF00FF;
-                    uint32_t dstG  = dst & 0x0000FF00;
+            template <typename U>
+            allocator(const allocator<U>&) noexcept {}
 
-                    uint32_t srcRB = src & 0x00FF00FF;
-                    uint32_t srcG  = src & 0x0000FF00;
+            T* allocate(size_t count) {
+                return static_cast<T*>(acquire(count * sizeof(T)));
+            }
 
-                    uint32_t invA = 255 - srcA;
+            void deallocate(T* ptr, size_t count) noexcept {
+                release(ptr, count * sizeof(T));
+            }
 
-                    dstRB = (dstRB * invA) >> 8;
-                    dstG  = (dstG  * invA) >> 8;
+            template <typename U>
+            bool operator==(const allocator<U>&) const noexcept { return true; }
+            template <typename U>
+            bool operator!=(const allocator<U>&) const noexcept { return false; }
+        };
+    }
 
-                    srcRB = (srcRB * srcA) >> 8;
-                    srcG  = (srcG  * srcA) >> 8;
+    // A work-stealing thread pool for everything in winhelp: big fills, blits
+    // and polygons split their rows over it, parallel_for and Graph are there
+    // for anything else. Sized from hardware_concurrency(), set_threads(1)
+    // runs every job on the calling thread, in order (deterministic, and what
+    // a single core machine gets anyway).
+    // Jobs go on the queue of the thread that made them and idle workers steal
+    // from the other end. A thread waiting on its jobs runs queued ones rather
+    // than blocking, so jobs can start jobs. Jobs must not throw.
+    namespace jobs {
+        // Scratch memory for one thread, a bump allocator over blocks that are
+        // kept between jobs. Whatever a job takes is handed back when it returns.
+        class Arena {
+        public:
+            struct Mark {
+                size_t block = 0;
+                size_t used = 0;
+            };
+
+            Arena() {}
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            ~Arena() {
+                for (Block& b : blocks)
+                    ::operator delete(b.data, std::align_val_t(64));
+            }
 
-                    uint32_t outRB = (srcRB + dstRB) & 0x00FF00FF;
-                    uint32_t outG  = (srcG  + dstG ) & 0x0000FF00;
+            void* allocate(size_t bytes, size_t align = 16) {
+                while (true) {
+                    if (current < blocks.size()) {
+                        Block& b = blocks[current];
+                        size_t at = (used + align - 1) & ~(align - 1);
+                        if (at + bytes <= b.size) {
+                            used = at + bytes;
+                            return b.data + at;
+                        }
+                        if (used > 0) {
+                            // doesn't fit what's left, on to the next block
+                            ++current;
+                            used = 0;
+                            continue;
+                        }
+                        // an empty block that is too small, nothing in it to keep
+                        ::operator delete(b.data, std::align_val_t(64));
+                        blocks.erase(blocks.begin() + current);
+                    }
 
-                    dst = 0xFF000000 | outRB | outG;
+                    size_t size = std::max<size_t>((size_t)64 << 10, bytes + align);
+                    blocks.insert(blocks.begin() + std::min(current, blocks.size()),
+                        { static_cast<char*>(::operator new(size, std::align_val_t(64))), size });
+                    used = 0;
                 }
             }
-        }
-    };
 
-    namespace events {
-        enum class eventTypes {
-            key_down,
-            key_up,
-            mouse_down,
-            mouse_up,
-            mouse_move,
-            scroll_wheel_up,
-            scroll_wheel_down,
-            quit,
-            minimized,
-            fullscreened,
-            charin,
-        };
+            template <typename T>
+            T* allocate(size_t count) {
+                return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+            }
 
-        enum class key {
-            A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P, Q, R, S, T, U, V, W, X, Y, Z,
-            Num0, Num1, Num2, Num3, Num4, Num5, Num6, Num7, Num8, Num9,
-            Left, Right, Up, Down,
-            Space, Enter, Escape, Tab, Backspace, Delete, Shift, Ctrl, Alt,
-            F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
-            none
-        };
+            Mark mark() const {
+                return { current, used };
+            }
 
-        enum class mouse {
-            left, right, middle, none
-        };
+            // free everything allocated since m
+            void rewind(Mark m) {
+                current = m.block;
+                used = m.used;
+            }
 
-        struct event {
-            eventTypes type;
-            vec2 hit;
-            key key;
-            mouse click;
-            uint32_t KeyAsChar;
+            size_t capacity() const {
+                size_t total = 0;
+                for (const Block& b : blocks)
+                    total += b.size;
+                return total;
+            }
+
+        private:
+            struct Block {
+                char* data;
+                size_t size;
+            };
+
+            std::vector<Block> blocks;
+            size_t current = 0; // block being allocated from
+            size_t used = 0;    // bytes of it taken
         };
 
-        inline std::vector<event>& queue() {
-            static std::vector<event> internalQueue;
-            return internalQueue;
+        // this thread's arena, workers and callers alike
+        inline Arena& scratch() {
+            thread_local Arena arena;
+            return arena;
         }
 
-        inline std::vector<event> get() {
-            MSG message;
-            while (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE)) {
-                TranslateMessage(&message);
-                DispatchMessageW(&message);
+        namespace internal {
+            struct Task {
+                void (*run)(void* context, size_t index);
+                void* context;
+                size_t index;
+                std::atomic<size_t>* pending; // counted down once run returns
+            };
+
+            struct Queue {
+                std::mutex lock;
+                std::deque<Task> tasks;
+            };
+
+            struct State {
+                std::mutex lock; // starting/stopping workers, and sleeping
+                std::condition_variable wake;
+                std::condition_variable done; // a wait's last job finished, or more were queued
+                std::vector<std::thread> workers;
+                std::vector<std::unique_ptr<Queue>> queues; // one per worker, the last shared by other threads
+                std::atomic<size_t> queued{ 0 };
+                std::atomic<int> threads{ 0 }; // including the caller, 0 until decided
+                std::atomic<int> minWork{ 1 << 16 };
+                std::atomic<bool> started{ false };
+                std::atomic<int> sleeping{ 0 }; // workers waiting for jobs
+                std::atomic<int> waiting{ 0 };  // threads asleep in wait()
+                bool stop = false;
+            };
+
+            // never destroyed, like the pixel pool
+            inline State& state() {
+                static State* s = new State();
+                return *s;
             }
-            std::vector<event> output = queue();
-            queue().clear();
-            return output;
-        }
-    }
 
-    struct display {
-        vec2 size;
-        std::string title;
-        HWND handle;
-        Surface surface;
+            // which queue is this thread's, -1 for threads that aren't workers
+            inline int& self() {
+                thread_local int index = -1;
+                return index;
+            }
 
-        BITMAPINFO bitmapInfo{};
+            inline void execute(const Task& task) {
+                Arena& arena = scratch();
+                Arena::Mark m = arena.mark();
+                task.run(task.context, task.index);
+                arena.rewind(m);
+
+                // pending can be gone as soon as it reads 0, after that only
+                // State is touched. Same ordering as sleeping/queued in worker.
+                State& s = state();
+                if (task.pending->fetch_sub(1) == 1 && s.waiting.load() > 0) {
+                    { std::lock_guard<std::mutex> guard(s.lock); }
+                    s.done.notify_all();
+                }
+            }
 
-        display(vec2 displaySize, std::string windowTitle)
-            : size(displaySize),
-            title(windowTitle),
-            handle(nullptr),
-            surface(displaySize)
-        {
-            static HINSTANCE instance = GetModuleHandleW(nullptr);
-            static bool registered = false;
+            // own queue newest first, then the oldest job of every other one
+            inline bool pop(State& s, Task& out) {
+                int count = (int)s.queues.size();
+                int own = self() >= 0 ? self() : count - 1;
 
-            if (!registered) {
-                WNDCLASSW windowClass{};
-                windowClass.lpfnWndProc = wndproc;
-                windowClass.hInstance = instance;
-                windowClass.lpszClassName = L"winhelp";
-                windowClass.hCursor = LoadCursor(nullptr, IDC_ARROW);
+                for (int i = 0; i < count; ++i) {
+                    Queue& q = *s.queues[(own + i) % count];
+                    std::lock_guard<std::mutex> guard(q.lock);
+                    if (q.tasks.empty())
+                        continue;
 
-                if (!RegisterClassW(&windowClass)) {
-                    if (GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
-                        MessageBoxA(NULL, "RegisterClass failed", "Error", MB_OK);
-                        return;
+                    if (i == 0) {
+                        out = q.tasks.back();
+                        q.tasks.pop_back();
+                    } else {
+                        out = q.tasks.front();
+                        q.tasks.pop_front();
                     }
+                    s.queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
                 }
-
-                registered = true;
+                return false;
             }
 
-            std::wstring wideTitle(title.begin(), title.end());
+            inline void worker(State& s, int index) {
+                self() = index;
+                Task task;
 
-            handle = CreateWindowW(
-                L"winhelp",
-                wideTitle.c_str(),
-                WS_OVERLAPPEDWINDOW,
-                CW_USEDEFAULT,
-                CW_USEDEFAULT,
-                (int)size.x,
-                (int)size.y,
-                nullptr,
-                nullptr,
-                instance,
-                nullptr
-            );
+                while (true) {
+                    if (pop(s, task)) {
+                        execute(task);
+                        continue;
+                    }
 
-            if (!handle) {
-                DWORD err = GetLastError();
+                    // sleeping goes up before queued is looked at, and push
+                    // looks at sleeping after queued goes up, one of them sees the other
+                    std::unique_lock<std::mutex> guard(s.lock);
+                    s.sleeping++;
+                    s.wake.wait(guard, [&] { return s.stop || s.queued.load() > 0; });
+                    s.sleeping--;
+                    if (s.stop)
+                        return;
+                }
+            }
 
-                LPSTR msg = nullptr;
-                FormatMessageA(
-                    FORMAT_MESSAGE_ALLOCATE_BUFFER |
-                    FORMAT_MESSAGE_FROM_SYSTEM |
-                    FORMAT_MESSAGE_IGNORE_INSERTS,
-                    NULL,
-                    err,
-                    0,
-                    (LPSTR)&msg,
-                    0,
-                    NULL
-                );
+            inline void start(State& s) {
+                std::lock_guard<std::mutex> guard(s.lock);
+                if (s.started.load())
+                    return;
+
+                int workers = s.threads.load() - 1;
+                for (int i = 0; i <= workers; ++i)
+                    s.queues.push_back(std::make_unique<Queue>());
+                for (int i = 0; i < workers; ++i)
+                    s.workers.emplace_back(worker, std::ref(s), i);
+                s.started.store(true, std::memory_order_release);
+            }
 
-                MessageBoxA(NULL, msg ? msg : "Unknown error",
-                            "CreateWindowEx failed", MB_OK);
+            // count jobs run(context, 0..count), all counted down on pending
+            inline void push(void (*run)(void*, size_t), void* context, size_t first, size_t count,
+                std::atomic<size_t>* pending) {
 
-                if (msg) LocalFree(msg);
-                return;
+                State& s = state();
+                if (!s.started.load(std::memory_order_acquire))
+                    start(s);
+
+                Queue& q = *s.queues[self() >= 0 ? self() : s.queues.size() - 1];
+                {
+                    std::lock_guard<std::mutex> guard(q.lock);
+                    for (size_t i = 0; i < count; ++i)
+                        q.tasks.push_back({ run, context, first + i, pending });
+                }
+                s.queued.fetch_add(count);
+                int sleeping = s.sleeping.load();
+                int waiting = s.waiting.load();
+                if (sleeping == 0 && waiting == 0)
+                    return;
+
+                // callers asleep in wait() can help with them too
+                { std::lock_guard<std::mutex> guard(s.lock); }
+                if (count == 1)
+                    s.wake.notify_one();
+                else
+                    s.wake.notify_all();
+                if (waiting > 0)
+                    s.done.notify_all();
             }
 
-            ShowWindow(handle, SW_SHOW);
-            UpdateWindow(handle);
+            // help out until pending reaches 0. Once there's nothing left to
+            // take it spins a little (most jobs are about to finish), then
+            // sleeps until its last job finishes or more are queued, so a
+            // caller waiting on one long job doesn't burn a core.
+            inline void wait(std::atomic<size_t>& pending) {
+                State& s = state();
+                Task task;
+                int idle = 0;
+
+                while (pending.load(std::memory_order_acquire) > 0) {
+                    if (pop(s, task)) {
+                        execute(task);
+                        idle = 0;
+                        continue;
+                    }
 
-            configure_bitmap();
-        }
+                    if (++idle < 64) {
+                        std::this_thread::yield();
+                        continue;
+                    }
 
-        void configure_bitmap() {
-            ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
-            bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-            bitmapInfo.bmiHeader.biWidth = (int)size.x;
+                    std::unique_lock<std::mutex> guard(s.lock);
+                    s.waiting++;
+                    s.done.wait(guard, [&] { return pending.load() == 0 || s.queued.load() > 0; });
+                    s.waiting--;
+                    idle = 0;
+                }
+            }
+
+            // the serial path, scratch handed back the same as for a job
+            template <typename F>
+            void inline_job(F& fn, int begin, int end) {
+                Arena& arena = scratch();
+                Arena::Mark m = arena.mark();
+                fn(begin, end);
+                arena.rewind(m);
+            }
+        }
+
+        // threads that run jobs, counting the one that waits for them
+        inline int thread_count() {
+            internal::State& s = internal::state();
+            int threads = s.threads.load(std::memory_order_relaxed);
+            if (threads == 0) {
+                int hardware = (int)std::thread::hardware_concurrency();
+                s.threads.compare_exchange_strong(threads, std::max(hardware, 1));
+                threads = s.threads.load();
+            }
+            return threads;
+        }
+
+        // 0 goes back to hardware_concurrency(), 1 is no workers at all. Not
+        // while jobs are running; workers start again on the next job.
+        inline void set_threads(int count) {
+            internal::State& s = internal::state();
+            {
+                std::lock_guard<std::mutex> guard(s.lock);
+                s.stop = true;
+            }
+            s.wake.notify_all();
+            for (std::thread& t : s.workers)
+                t.join();
+
+            std::lock_guard<std::mutex> guard(s.lock);
+            s.workers.clear();
+            s.queues.clear();
+            s.started = false;
+            s.stop = false;
+            s.threads = std::max(count, 0);
+        }
+
+        // least work (in pixels, or whatever rowCost counts) worth a job of its
+        // own, below it parallel_rows doesn't split. 64K by default.
+        inline void set_min_work(int amount) {
+            internal::state().minWork = std::max(amount, 1);
+        }
+
+        inline int min_work() {
+            return internal::state().minWork.load(std::memory_order_relaxed);
+        }
+
+        // fn(from, to) over [begin, end) in pieces of grain, spread over the
+        // threads, returns when every piece is done. With one thread it's a
+        // single fn(begin, end).
+        template <typename F>
+        void parallel_for(int begin, int end, int grain, F&& fn) {
+            if (end <= begin)
+                return;
+
+            grain = std::max(grain, 1);
+            size_t pieces = ((size_t)end - begin + grain - 1) / grain;
+            if (pieces <= 1 || thread_count() <= 1) {
+                internal::inline_job(fn, begin, end);
+                return;
+            }
+
+            struct Context {
+                std::remove_reference_t<F>* fn;
+                int begin, end, grain;
+            } context{ &fn, begin, end, grain };
+
+            std::atomic<size_t> pending(pieces);
+            internal::push([](void* c, size_t i) {
+                Context& x = *static_cast<Context*>(c);
+                int from = x.begin + (int)i * x.grain;
+                (*x.fn)(from, std::min(x.end, from + x.grain));
+            }, &context, 0, pieces, &pending);
+            internal::wait(pending);
+        }
+
+        // fn(from, to) over rows [y0, y1) that cost about rowCost each (pixels
+        // wide, usually). Small work stays on this thread as one call, big work
+        // is a few jobs per thread, each at least min_work().
+        template <typename F>
+        void parallel_rows(int y0, int y1, int rowCost, F&& fn) {
+            if (y1 <= y0)
+                return;
+
+            int rows = y1 - y0;
+            int threads = thread_count();
+            int minWork = min_work();
+            if (threads <= 1 || (int64_t)rows * rowCost < 2 * (int64_t)minWork) {
+                internal::inline_job(fn, y0, y1);
+                return;
+            }
+
+            int grain = std::max(minWork / std::max(rowCost, 1), 1);
+            grain = std::max(grain, (rows + threads * 4 - 1) / (threads * 4));
+            parallel_for(y0, y1, grain, fn);
+        }
+
+        // Jobs with dependencies, built once and run as often as needed. A job
+        // starts once every job it was added after has finished, jobs that
+        // don't depend on each other run at the same time. On one thread they
+        // run in the order they were added.
+        class Graph {
+        public:
+            Graph() {}
+            Graph(Graph&&) = default;
+            Graph& operator=(Graph&&) = default;
+
+            // the new job's id; after can only name jobs added before it
+            size_t add(std::function<void()> fn, std::initializer_list<size_t> after = {}) {
+                size_t id = nodes.size();
+                for (size_t before : after)
+                    if (before >= id)
+                        throw std::invalid_argument("jobs::Graph: a job can only wait for jobs added before it");
+
+                nodes.push_back({ std::move(fn), {}, after.size() });
+                for (size_t before : after)
+                    nodes[before].next.push_back(id);
+                return id;
+            }
+
+            void run() {
+                WINHELP_PROFILE_SCOPE("jobs::Graph::run");
+
+                if (nodes.empty())
+                    return;
+
+                if (thread_count() <= 1) {
+                    Arena& arena = scratch();
+                    for (Node& n : nodes) {
+                        Arena::Mark m = arena.mark();
+                        n.fn();
+                        arena.rewind(m);
+                    }
+                    return;
+                }
+
+                // a waiting count per job, then the number not yet finished
+                if (!counts || countsSize != nodes.size() + 1) {
+                    counts = std::make_unique<std::atomic<size_t>[]>(nodes.size() + 1);
+                    countsSize = nodes.size() + 1;
+                }
+                for (size_t i = 0; i < nodes.size(); ++i)
+                    counts[i].store(nodes[i].waitsFor, std::memory_order_relaxed);
+                std::atomic<size_t>& pending = counts[nodes.size()];
+                pending.store(nodes.size(), std::memory_order_release);
+
+                for (size_t i = 0; i < nodes.size(); ++i)
+                    if (nodes[i].waitsFor == 0)
+                        internal::push(step, this, i, 1, &pending);
+                internal::wait(pending);
+            }
+
+            size_t size() const {
+                return nodes.size();
+            }
+
+            void clear() {
+                nodes.clear();
+            }
+
+        private:
+            struct Node {
+                std::function<void()> fn;
+                std::vector<size_t> next; // jobs waiting on this one
+                size_t waitsFor;
+            };
+
+            std::vector<Node> nodes;
+            std::unique_ptr<std::atomic<size_t>[]> counts;
+            size_t countsSize = 0;
+
+            static void step(void* context, size_t index) {
+                Graph& g = *static_cast<Graph*>(context);
+                g.nodes[index].fn();
+                for (size_t n : g.nodes[index].next)
+                    if (g.counts[n].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        internal::push(step, &g, n, 1, &g.counts[g.nodes.size()]);
+            }
+        };
+    }
+
+    // integer rectangle covering [x0, x1) x [y0, y1)
+    struct irect {
+        int x0, y0;
+        int x1, y1;
+
+        irect() : x0(0), y0(0), x1(0), y1(0) {}
+        irect(int X0, int Y0, int X1, int Y1) : x0(X0), y0(Y0), x1(X1), y1(Y1) {}
+
+        bool empty() const { return x0 >= x1 || y0 >= y1; }
+
+        irect intersect(const irect& other) const {
+            return {
+                std::max(x0, other.x0), std::max(y0, other.y0),
+                std::min(x1, other.x1), std::min(y1, other.y1)
+            };
+        }
+    };
+
+    inline vec2& internal_mouse() {
+        static vec2 pos;
+        return pos;
+    }
+
+    inline vec2 mouse() {
+        return internal_mouse();
+    }
+
+    // How a blit puts source pixels onto what is already there. Every mode
+    // also takes an opacity, the source alpha (if it has one) is scaled by it.
+    enum class blend_mode {
+        alpha,    // source over target
+        add,      // target + source, clamped at white (glow, lights)
+        multiply, // target * source (shadows, light maps, tinting)
+        screen,   // 1 - (1 - target)(1 - source), add that never blows out
+        min,      // darker of the two, per channel
+        max       // lighter of the two, per channel
+    };
+
+    namespace internal_blend {
+
+        // round(v / 255) for v in [0, 255 * 255]
+        inline uint32_t div255(uint32_t v) {
+            v += 128;
+            return (v + (v >> 8)) >> 8;
+        }
+
+        // One channel of the target (d) under the source (s) at coverage a,
+        // everything 0..255. a = 255 is the plain mode, a = 0 leaves d alone.
+        template <blend_mode M>
+        inline uint32_t channel(uint32_t d, uint32_t s, uint32_t a) {
+            if constexpr (M == blend_mode::alpha)
+                return div255(d * (255 - a) + s * a);
+            else if constexpr (M == blend_mode::add)
+                return std::min(255u, d + div255(s * a));
+            else if constexpr (M == blend_mode::multiply)
+                return div255(d * (255 - a + div255(s * a)));
+            else if constexpr (M == blend_mode::screen)
+                return d + div255(div255(s * a) * (255 - d));
+            else if constexpr (M == blend_mode::min)
+                return div255(d * (255 - a) + std::min(d, s) * a);
+            else
+                return div255(d * (255 - a) + std::max(d, s) * a);
+        }
+
+#ifdef WINHELP_SSE2
+        // the same, on eight 16 bit lanes (two pixels) at once. No product
+        // goes past 255 * 255 so unsigned 16 bits is always enough.
+        inline __m128i div255(__m128i v) {
+            v = _mm_add_epi16(v, _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+        }
+
+        template <blend_mode M>
+        inline __m128i channels(__m128i d, __m128i s, __m128i a) {
+            const __m128i full = _mm_set1_epi16(255);
+            __m128i inv = _mm_sub_epi16(full, a);
+
+            if constexpr (M == blend_mode::alpha)
+                return div255(_mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_mullo_epi16(s, a)));
+            else if constexpr (M == blend_mode::add)
+                return _mm_min_epi16(full, _mm_add_epi16(d, div255(_mm_mullo_epi16(s, a))));
+            else if constexpr (M == blend_mode::multiply)
+                return div255(_mm_mullo_epi16(d, _mm_add_epi16(inv, div255(_mm_mullo_epi16(s, a)))));
+            else if constexpr (M == blend_mode::screen)
+                return _mm_add_epi16(d, div255(_mm_mullo_epi16(div255(_mm_mullo_epi16(s, a)), _mm_sub_epi16(full, d))));
+            else if constexpr (M == blend_mode::min)
+                return div255(_mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_mullo_epi16(_mm_min_epi16(d, s), a)));
+            else
+                return div255(_mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_mullo_epi16(_mm_max_epi16(d, s), a)));
+        }
+#endif
+
+        // count pixels of src onto dst. One of these gets built per mode and
+        // per where the coverage comes from (opacity, source alpha or both), so
+        // the loop itself never asks which it is.
+        template <blend_mode M, bool SourceAlpha, bool Scaled>
+        inline void row(uint32_t* dst, const uint32_t* src, int count, uint32_t opacity) {
+            int x = 0;
+
+#ifdef WINHELP_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+            const __m128i scale = _mm_set1_epi16((short)opacity);
+
+            for (; x + 4 <= count; x += 4) {
+                __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+                __m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+
+                __m128i dLo = _mm_unpacklo_epi8(d, zero), dHi = _mm_unpackhi_epi8(d, zero);
+                __m128i sLo = _mm_unpacklo_epi8(s, zero), sHi = _mm_unpackhi_epi8(s, zero);
+
+                __m128i aLo = scale, aHi = scale;
+                if constexpr (SourceAlpha) {
+                    // each pixel's alpha into all four of its lanes
+                    aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0xFF), 0xFF);
+                    aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0xFF), 0xFF);
+                    if constexpr (Scaled) {
+                        aLo = div255(_mm_mullo_epi16(aLo, scale));
+                        aHi = div255(_mm_mullo_epi16(aHi, scale));
+                    }
+                }
+
+                __m128i out = _mm_packus_epi16(channels<M>(dLo, sLo, aLo), channels<M>(dHi, sHi, aHi));
+                _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(out, opaque));
+            }
+#endif
+
+            for (; x < count; ++x) {
+                uint32_t s = src[x];
+                uint32_t d = dst[x];
+                uint32_t a = !SourceAlpha ? opacity : Scaled ? div255((s >> 24) * opacity) : s >> 24;
+
+                dst[x] = 0xFF000000 |
+                    (channel<M>((d >> 16) & 0xFF, (s >> 16) & 0xFF, a) << 16) |
+                    (channel<M>((d >> 8) & 0xFF, (s >> 8) & 0xFF, a) << 8) |
+                    channel<M>(d & 0xFF, s & 0xFF, a);
+            }
+        }
+
+        // count pixels of one colour onto dst, each at its mask coverage scaled
+        // by alpha (0..255). Four clear mask bytes in a row are skipped whole,
+        // glyphs are mostly that.
+        template <blend_mode M>
+        inline void mask_row(uint32_t* dst, const uint8_t* mask, int count, uint32_t colour, uint32_t alpha) {
+            int x = 0;
+
+#ifdef WINHELP_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+            const __m128i scale = _mm_set1_epi16((short)alpha);
+            const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int)colour), zero);
+
+            for (; x + 4 <= count; x += 4) {
+                uint32_t cover;
+                memcpy(&cover, mask + x, 4);
+                if (!cover)
+                    continue;
+
+                // coverage into all four lanes of its pixel
+                __m128i m = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)cover), zero);
+                m = _mm_unpacklo_epi16(m, m);
+                __m128i aLo = div255(_mm_mullo_epi16(_mm_unpacklo_epi32(m, m), scale));
+                __m128i aHi = div255(_mm_mullo_epi16(_mm_unpackhi_epi32(m, m), scale));
+
+                __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+                __m128i out = _mm_packus_epi16(
+                    channels<M>(_mm_unpacklo_epi8(d, zero), src, aLo),
+                    channels<M>(_mm_unpackhi_epi8(d, zero), src, aHi));
+                _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(out, opaque));
+            }
+#endif
+
+            for (; x < count; ++x) {
+                if (!mask[x])
+                    continue;
+
+                uint32_t a = div255(mask[x] * alpha);
+                uint32_t d = dst[x];
+
+                dst[x] = 0xFF000000 |
+                    (channel<M>((d >> 16) & 0xFF, (colour >> 16) & 0xFF, a) << 16) |
+                    (channel<M>((d >> 8) & 0xFF, (colour >> 8) & 0xFF, a) << 8) |
+                    channel<M>(d & 0xFF, colour & 0xFF, a);
+            }
+        }
+
+        using mask_fn = void (*)(uint32_t*, const uint8_t*, int, uint32_t, uint32_t);
+
+        inline mask_fn pick_mask(blend_mode mode) {
+            switch (mode) {
+                case blend_mode::add:      return &mask_row<blend_mode::add>;
+                case blend_mode::multiply: return &mask_row<blend_mode::multiply>;
+                case blend_mode::screen:   return &mask_row<blend_mode::screen>;
+                case blend_mode::min:      return &mask_row<blend_mode::min>;
+                case blend_mode::max:      return &mask_row<blend_mode::max>;
+                default:                   return &mask_row<blend_mode::alpha>;
+            }
+        }
+
+        using row_fn = void (*)(uint32_t*, const uint32_t*, int, uint32_t);
+
+        template <blend_mode M>
+        inline row_fn pick(bool sourceAlpha, bool scaled) {
+            if (!sourceAlpha)
+                return &row<M, false, true>;
+            return scaled ? &row<M, true, true> : &row<M, true, false>;
+        }
+
+        // the one switch, once per blit
+        inline row_fn pick(blend_mode mode, bool sourceAlpha, uint32_t opacity) {
+            bool scaled = opacity != 255;
+            switch (mode) {
+                case blend_mode::add:      return pick<blend_mode::add>(sourceAlpha, scaled);
+                case blend_mode::multiply: return pick<blend_mode::multiply>(sourceAlpha, scaled);
+                case blend_mode::screen:   return pick<blend_mode::screen>(sourceAlpha, scaled);
+                case blend_mode::min:      return pick<blend_mode::min>(sourceAlpha, scaled);
+                case blend_mode::max:      return pick<blend_mode::max>(sourceAlpha, scaled);
+                default:                   return pick<blend_mode::alpha>(sourceAlpha, scaled);
+            }
+        }
+    }
+
+    // Pixels that are only read: what gets blitted, scaled, transformed or
+    // RLE encoded. Views and Surfaces (const ones too) turn into one, and
+    // nothing draws into it, so a const Surface can't be written through.
+    struct SourceView {
+        const uint32_t* pixels = nullptr;
+        ivec2 size;
+        int pitch = 0;
+        bool hasAlpha = false;
+
+        SourceView() {}
+
+        SourceView(const uint32_t* data, ivec2 viewSize, int rowPitch, bool alpha = false)
+            : pixels(data), size(viewSize), pitch(rowPitch), hasAlpha(alpha) {}
+
+        const uint32_t* row(int y) const {
+            return pixels + (size_t)y * pitch;
+        }
+    };
+
+    // Pixels owned by something else (a Surface, or part of one) to draw into
+    // in place, rows are pitch pixels apart. Everything in draw:: takes a view
+    // and a Surface turns into one covering all of itself, so drawing into a
+    // region needs no extra Surface and no copy.
+    struct SurfaceView {
+        uint32_t* pixels = nullptr;
+        ivec2 size;
+        int pitch = 0;  // pixels from the start of one row to the next
+        irect clip;     // where drawing may go, always inside [0, size)
+        bool hasAlpha = false;
+
+        SurfaceView() {}
+
+        SurfaceView(uint32_t* data, ivec2 viewSize, int rowPitch, bool alpha = false)
+            : pixels(data), size(viewSize), pitch(rowPitch),
+            clip(0, 0, viewSize.x, viewSize.y), hasAlpha(alpha) {}
+
+        uint32_t* row(int y) const {
+            return pixels + (size_t)y * pitch;
+        }
+
+        irect clipRect() const {
+            return clip;
+        }
+
+        operator SourceView() const {
+            return SourceView(pixels, size, pitch, hasAlpha);
+        }
+
+        // pos/size of this view (cut to fit) as its own view, same pixels.
+        // Keeps whatever part of the clip falls inside it.
+        SurfaceView sub(vec2 pos, vec2 subSize) const {
+            int x = (int)pos.x;
+            int y = (int)pos.y;
+            irect area = irect(x, y, x + (int)subSize.x, y + (int)subSize.y)
+                .intersect(irect(0, 0, size.x, size.y));
+
+            if (area.empty())
+                return SurfaceView(pixels, { 0, 0 }, pitch, hasAlpha);
+
+            SurfaceView v(row(area.y0) + area.x0, { area.x1 - area.x0, area.y1 - area.y0 }, pitch, hasAlpha);
+            irect inside = clip.intersect(area);
+            v.clip = inside.empty() ? irect() :
+                irect(inside.x0 - area.x0, inside.y0 - area.y0, inside.x1 - area.x0, inside.y1 - area.y0);
+            return v;
+        }
+
+        void fill(uint32_t value) const {
+            WINHELP_PROFILE_SCOPE("Surface::fill");
+
+            if (clip.empty())
+                return;
+
+            // big ones are split into bands of rows over the job threads
+            jobs::parallel_rows(clip.y0, clip.y1, clip.x1 - clip.x0, [&](int y0, int y1) {
+                // whole rows of a packed view, one run
+                if (clip.x0 == 0 && clip.x1 == size.x && pitch == size.x) {
+                    uint32_t* ptr = row(y0);
+                    uint32_t* end = row(y1);
+                    while (ptr < end)
+                        *ptr++ = value;
+                    return;
+                }
+
+                for (int y = y0; y < y1; ++y) {
+                    uint32_t* ptr = row(y) + clip.x0;
+                    uint32_t* end = ptr + (clip.x1 - clip.x0);
+                    while (ptr < end)
+                        *ptr++ = value;
+                }
+            });
+        }
+
+        void blit(vec2 position, const SourceView& source, bool blend = true) const {
+            if (blend) {
+                blit(position, source, blend_mode::alpha);
+                return;
+            }
+
+            // straight copy, alpha and all
+            SourceView opaque = source;
+            opaque.hasAlpha = false;
+            blit(position, opaque, blend_mode::alpha);
+        }
+
+        // source onto this view with the given mode, opacity 0..255 on top of
+        // the source's own alpha (which only counts if source.hasAlpha)
+        void blit(vec2 position, const SourceView& source, blend_mode mode, int opacity = 255) const {
+            WINHELP_PROFILE_SCOPE("Surface::blit");
+
+            int startX = std::max(clip.x0, (int)position.x);
+            int startY = std::max(clip.y0, (int)position.y);
+
+            int endX = std::min(clip.x1, (int)position.x + source.size.x);
+            int endY = std::min(clip.y1, (int)position.y + source.size.y);
+
+            opacity = std::clamp(opacity, 0, 255);
+
+            if (startX >= endX || startY >= endY || opacity == 0)
+                return;
+
+            int srcOffsetX = startX - (int)position.x;
+            int srcOffsetY = startY - (int)position.y;
+
+            // i am speed
+            if (mode == blend_mode::alpha && opacity == 255 && !source.hasAlpha) {
+                jobs::parallel_rows(startY, endY, endX - startX, [&](int y0, int y1) {
+                    for (int y = y0; y < y1; ++y) {
+
+                        uint32_t* dstRow = row(y) + startX;
+                        const uint32_t* srcRow = source.row(y - startY + srcOffsetY) + srcOffsetX;
+
+                        memcpy(dstRow, srcRow,
+                            (endX - startX) * sizeof(uint32_t));
+                    }
+                });
+
+                return;
+            }
+
+            internal_blend::row_fn blendRow = internal_blend::pick(mode, source.hasAlpha, (uint32_t)opacity);
+
+            // blending costs a few times a copy per pixel, it splits sooner
+            jobs::parallel_rows(startY, endY, (endX - startX) * 4, [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                    blendRow(row(y) + startX,
+                        source.row(y - startY + srcOffsetY) + srcOffsetX,
+                        endX - startX, (uint32_t)opacity);
+                }
+            });
+        }
+    };
+
+    struct Surface {
+        ivec2 size;
+        int pitch = 0; // pixels from the start of one row to the next, >= size.x
+
+        // pitch * size.y pixels from the pool, the first one on a 64 byte
+        // boundary. Row y starts at pixels[y * pitch], past size.x is padding.
+        std::vector<uint32_t, pool::allocator<uint32_t>> pixels;
+        bool hasAlpha = false;
+
+        // pushed clip rects, each one already cut down to the one below it
+        std::vector<irect> clipStack;
+
+        Surface() : size(0, 0) {}
+
+        // rowPitch 0 packs the rows, alignedPitch(width) starts each one on a
+        // cache line (SIMD friendly, and threads on different rows never share one)
+        Surface(vec2 surfaceSize, int rowPitch = 0)
+            : size(std::max(0, (int)surfaceSize.x), std::max(0, (int)surfaceSize.y)),
+            pitch(std::max(rowPitch, size.x)),
+            pixels((size_t)pitch * size.y, 0xFF000000) {}
+
+        // smallest pitch >= width that is a whole number of 64 byte lines
+        static int alignedPitch(int width) {
+            return (std::max(width, 0) + 15) & ~15;
+        }
+
+        uint32_t* row(int y) {
+            return pixels.data() + (size_t)y * pitch;
+        }
+
+        const uint32_t* row(int y) const {
+            return pixels.data() + (size_t)y * pitch;
+        }
+
+        static uint32_t pack(const vec4& c) {
+            return
+                (uint32_t(c.w) << 24) |
+                (uint32_t(c.x) << 16) |
+                (uint32_t(c.y) << 8)  |
+                uint32_t(c.z);
+        }
+
+        static vec4 unpack(uint32_t v) {
+            return vec4(
+                float((v >> 16) & 0xFF),
+                float((v >> 8)  & 0xFF),
+                float(v & 0xFF),
+                float((v >> 24) & 0xFF)
+            );
+        }
+
+        // Only draw (fill, blit and everything in draw::) inside pos/size, on
+        // top of whatever clip is already pushed. popClip() goes back a level.
+        void pushClip(vec2 pos, vec2 clipSize) {
+            int x = (int)pos.x;
+            int y = (int)pos.y;
+            irect r(x, y, x + (int)clipSize.x, y + (int)clipSize.y);
+
+            clipStack.push_back(clipStack.empty() ? r : r.intersect(clipStack.back()));
+        }
+
+        void popClip() {
+            if (!clipStack.empty())
+                clipStack.pop_back();
+        }
+
+        // the area drawing may touch right now, always inside the surface
+        irect clipRect() const {
+            irect all(0, 0, size.x, size.y);
+            return clipStack.empty() ? all : all.intersect(clipStack.back());
+        }
+
+        // all of the surface (inside the current clip) as a view, or just part of it
+        SurfaceView view() {
+            SurfaceView v(pixels.data(), size, pitch, hasAlpha);
+            v.clip = clipRect();
+            return v;
+        }
+
+        SurfaceView view(vec2 pos, vec2 viewSize) {
+            return view().sub(pos, viewSize);
+        }
+
+        // so a Surface can go anywhere a view is taken (draw::)
+        operator SurfaceView() {
+            return view();
+        }
+
+        // and anywhere a source is, const or not
+        operator SourceView() const {
+            return SourceView(pixels.data(), size, pitch, hasAlpha);
+        }
+
+        void fill(vec4 colour) {
+            view().fill(pack(colour));
+        }
+
+        void blit(vec2 position, const SourceView& source, bool blend = true) {
+            view().blit(position, source, blend);
+        }
+
+        void blit(vec2 position, const SourceView& source, blend_mode mode, int opacity = 255) {
+            view().blit(position, source, mode, opacity);
+        }
+    };
+
+    // One byte of coverage per pixel (A8): glyphs, masks, anything that is a
+    // shape more than a picture. A quarter of a Surface, and the colour is
+    // picked when it is drawn (draw::blit_mask) instead of baked in.
+    struct MaskSurface {
+        ivec2 size;
+        int pitch = 0; // bytes from the start of one row to the next, >= size.x
+        std::vector<uint8_t, pool::allocator<uint8_t>> pixels;
+
+        MaskSurface() : size(0, 0) {}
+
+        MaskSurface(vec2 maskSize, int rowPitch = 0)
+            : size(std::max(0, (int)maskSize.x), std::max(0, (int)maskSize.y)),
+            pitch(std::max(rowPitch, size.x)),
+            pixels((size_t)pitch * size.y, 0) {}
+
+        uint8_t* row(int y) {
+            return pixels.data() + (size_t)y * pitch;
+        }
+
+        const uint8_t* row(int y) const {
+            return pixels.data() + (size_t)y * pitch;
+        }
+    };
+
+    // A sprite compiled into runs of see-through, solid and partly see-through
+    // pixels, for the text and UI sprites that are mostly the first two. Drawing
+    // one (draw::blit) jumps over the see-through runs, copies the solid ones
+    // and only blends the rest. Only the pixels of non see-through runs are kept.
+    struct RleSurface {
+        enum : uint32_t { skip = 0, opaque = 1, translucent = 2 };
+
+        ivec2 size;
+
+        // every row is a list of runs, a header (kind << 30 | length) and then,
+        // unless it is a skip, that many pixels. Trailing skips are left off.
+        std::vector<uint32_t> data;
+        std::vector<uint32_t> rows; // where row y starts in data, rows[y + 1] is where it ends
+
+        size_t opaquePixels = 0;
+        size_t translucentPixels = 0;
+
+        RleSurface() {}
+
+        explicit RleSurface(const SourceView& source) : size(source.size) {
+            rows.reserve((size_t)size.y + 1);
+
+            for (int y = 0; y < size.y; ++y) {
+                rows.push_back((uint32_t)data.size());
+                const uint32_t* src = source.row(y);
+
+                int x = 0;
+                while (x < size.x) {
+                    uint32_t kind = classify(source, src[x]);
+                    int end = x + 1;
+                    while (end < size.x && classify(source, src[end]) == kind)
+                        ++end;
+
+                    if (kind == skip && end == size.x)
+                        break;
+
+                    data.push_back(kind << 30 | (uint32_t)(end - x));
+                    if (kind != skip)
+                        data.insert(data.end(), src + x, src + end);
+
+                    if (kind == opaque)
+                        opaquePixels += end - x;
+                    else if (kind == translucent)
+                        translucentPixels += end - x;
+                    x = end;
+                }
+            }
+
+            rows.push_back((uint32_t)data.size());
+            data.shrink_to_fit();
+        }
+
+        // what it takes in memory, next to 4 * size.x * size.y for a Surface
+        size_t bytes() const {
+            return (data.size() + rows.size()) * sizeof(uint32_t);
+        }
+
+    private:
+        static uint32_t classify(const SourceView& source, uint32_t pixel) {
+            if (!source.hasAlpha)
+                return opaque;
+
+            uint32_t a = pixel >> 24;
+            return a == 0 ? skip : a == 255 ? opaque : translucent;
+        }
+    };
+
+    // Text is UTF-8 everywhere, std::string in and out. Decoding is only
+    // done where it has to be: runs of ASCII, most UI text, are found 16 bytes
+    // at a time and handed over byte by byte, even between non-ASCII ones.
+    namespace utf8 {
+        constexpr uint32_t replacement = 0xFFFD; // what a broken sequence reads as
+
+        // the codepoint at text[at], at moves past it. A broken or overlong
+        // sequence, or a surrogate, is U+FFFD and skips one byte.
+        inline uint32_t next(std::string_view text, size_t& at) {
+            uint32_t c = (unsigned char)text[at];
+            if (c < 0x80) {
+                at++;
+                return c;
+            }
+
+            size_t length;
+            uint32_t codepoint, smallest;
+            if ((c & 0xE0) == 0xC0) {
+                length = 2;
+                codepoint = c & 0x1F;
+                smallest = 0x80;
+            } else if ((c & 0xF0) == 0xE0) {
+                length = 3;
+                codepoint = c & 0x0F;
+                smallest = 0x800;
+            } else if ((c & 0xF8) == 0xF0) {
+                length = 4;
+                codepoint = c & 0x07;
+                smallest = 0x10000;
+            } else {
+                at++;
+                return replacement;
+            }
+
+            if (at + length > text.size()) {
+                at++;
+                return replacement;
+            }
+
+            for (size_t i = 1; i < length; ++i) {
+                uint32_t follow = (unsigned char)text[at + i];
+                if ((follow & 0xC0) != 0x80) {
+                    at++;
+                    return replacement;
+                }
+                codepoint = codepoint << 6 | (follow & 0x3F);
+            }
+
+            if (codepoint < smallest || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+                at++;
+                return replacement;
+            }
+
+            at += length;
+            return codepoint;
+        }
+
+        // where the run of ASCII starting at text[at] ends, 16 bytes at a time
+        inline size_t ascii_run(std::string_view text, size_t at) {
+#ifdef WINHELP_SSE2
+            for (; at + 16 <= text.size(); at += 16)
+                if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(text.data() + at))))
+                    break; // the byte by byte loop finds which one
+#endif
+            while (at < text.size() && (unsigned char)text[at] < 0x80)
+                at++;
+            return at;
+        }
+
+        inline bool is_ascii(std::string_view text) {
+            return ascii_run(text, 0) == text.size();
+        }
+
+        // fn(codepoint, byte it starts at) for all of text. Only what isn't
+        // ASCII gets decoded, the runs in between go through byte by byte.
+        template <typename Fn>
+        void for_each(std::string_view text, Fn&& fn) {
+            for (size_t at = 0; at < text.size();) {
+                size_t end = ascii_run(text, at);
+                for (; at < end; ++at)
+                    fn((uint32_t)(unsigned char)text[at], at);
+
+                if (at < text.size()) {
+                    size_t start = at;
+                    uint32_t c = next(text, at);
+                    fn(c, start);
+                }
+            }
+        }
+
+        // codepoints in text
+        inline size_t length(std::string_view text) {
+            if (is_ascii(text))
+                return text.size();
+
+            size_t count = 0;
+            for_each(text, [&](uint32_t, size_t) { count++; });
+            return count;
+        }
+
+        inline void append(std::string& out, uint32_t codepoint) {
+            if (codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+                codepoint = replacement;
+
+            if (codepoint < 0x80) {
+                out += (char)codepoint;
+            } else if (codepoint < 0x800) {
+                out += (char)(0xC0 | codepoint >> 6);
+                out += (char)(0x80 | (codepoint & 0x3F));
+            } else if (codepoint < 0x10000) {
+                out += (char)(0xE0 | codepoint >> 12);
+                out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+                out += (char)(0x80 | (codepoint & 0x3F));
+            } else {
+                out += (char)(0xF0 | codepoint >> 18);
+                out += (char)(0x80 | (codepoint >> 12 & 0x3F));
+                out += (char)(0x80 | (codepoint >> 6 & 0x3F));
+                out += (char)(0x80 | (codepoint & 0x3F));
+            }
+        }
+
+        // for wide Win32 calls: UTF-16 where wchar_t is 16 bits (surrogate
+        // pairs past U+FFFF), a codepoint per wchar_t elsewhere
+        inline std::wstring widen(std::string_view text) {
+            std::wstring out;
+            out.reserve(text.size());
+
+            if (is_ascii(text)) {
+                out.assign(text.begin(), text.end());
+                return out;
+            }
+
+            for_each(text, [&](uint32_t codepoint, size_t) {
+                if (sizeof(wchar_t) == 2 && codepoint >= 0x10000) {
+                    codepoint -= 0x10000;
+                    out += (wchar_t)(0xD800 + (codepoint >> 10));
+                    out += (wchar_t)(0xDC00 + (codepoint & 0x3FF));
+                } else {
+                    out += (wchar_t)codepoint;
+                }
+            });
+            return out;
+        }
+    }
+
+    namespace events {
+        enum class eventTypes {
+            key_down,
+            key_up,
+            mouse_down,
+            mouse_up,
+            mouse_move,
+            scroll_wheel_up,
+            scroll_wheel_down,
+            quit,
+            minimized,
+            fullscreened,
+            charin,
+        };
+
+        enum class key {
+            A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P, Q, R, S, T, U, V, W, X, Y, Z,
+            Num0, Num1, Num2, Num3, Num4, Num5, Num6, Num7, Num8, Num9,
+            Left, Right, Up, Down,
+            Space, Enter, Escape, Tab, Backspace, Delete, Shift, Ctrl, Alt,
+            F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
+            none
+        };
+
+        enum class mouse {
+            left, right, middle, none
+        };
+
+        struct event {
+            eventTypes type;
+            vec2 hit;
+            events::key key;
+            mouse click;
+            uint32_t KeyAsChar; // charin: the whole codepoint, utf8::append it to a string
+        };
+
+        inline std::vector<event>& queue() {
+            static std::vector<event> internalQueue;
+            return internalQueue;
+        }
+
+        inline std::vector<event> get() {
+            WINHELP_PROFILE_SCOPE("events::get");
+#ifdef _WIN32
+            MSG message;
+            while (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE)) {
+                TranslateMessage(&message);
+                DispatchMessageW(&message);
+            }
+#endif
+            std::vector<event> output = queue();
+            queue().clear();
+            return output;
+        }
+    }
+
+#ifdef _WIN32
+    struct display {
+        vec2 size;
+        std::string title;
+        HWND handle;
+        Surface surface;
+
+        BITMAPINFO bitmapInfo{};
+
+        display(vec2 displaySize, std::string windowTitle)
+            : size(displaySize),
+            title(windowTitle),
+            handle(nullptr),
+            surface(displaySize, Surface::alignedPitch((int)displaySize.x))
+        {
+            static HINSTANCE instance = GetModuleHandleW(nullptr);
+            static bool registered = false;
+
+            if (!registered) {
+                WNDCLASSW windowClass{};
+                windowClass.lpfnWndProc = wndproc;
+                windowClass.hInstance = instance;
+                windowClass.lpszClassName = L"winhelp";
+                windowClass.hCursor = LoadCursor(nullptr, IDC_ARROW);
+
+                if (!RegisterClassW(&windowClass)) {
+                    if (GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+                        MessageBoxA(NULL, "RegisterClass failed", "Error", MB_OK);
+                        return;
+                    }
+                }
+
+                registered = true;
+            }
+
+            std::wstring wideTitle = utf8::widen(title);
+
+            handle = CreateWindowW(
+                L"winhelp",
+                wideTitle.c_str(),
+                WS_OVERLAPPEDWINDOW,
+                CW_USEDEFAULT,
+                CW_USEDEFAULT,
+                (int)size.x,
+                (int)size.y,
+                nullptr,
+                nullptr,
+                instance,
+                nullptr
+            );
+
+            if (!handle) {
+                DWORD err = GetLastError();
+
+                LPSTR msg = nullptr;
+                FormatMessageA(
+                    FORMAT_MESSAGE_ALLOCATE_BUFFER |
+                    FORMAT_MESSAGE_FROM_SYSTEM |
+                    FORMAT_MESSAGE_IGNORE_INSERTS,
+                    NULL,
+                    err,
+                    0,
+                    (LPSTR)&msg,
+                    0,
+                    NULL
+                );
+
+                MessageBoxA(NULL, msg ? msg : "Unknown error",
+                            "CreateWindowEx failed", MB_OK);
+
+                if (msg) LocalFree(msg);
+                return;
+            }
+
+            ShowWindow(handle, SW_SHOW);
+            UpdateWindow(handle);
+
+            configure_bitmap();
+        }
+
+        void configure_bitmap() {
+            ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
+            bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+            bitmapInfo.bmiHeader.biWidth = surface.pitch; // source rows are pitch apart
             bitmapInfo.bmiHeader.biHeight = -(int)size.y; // top-down
             bitmapInfo.bmiHeader.biPlanes = 1;
             bitmapInfo.bmiHeader.biBitCount = 32;
             bitmapInfo.bmiHeader.biCompression = BI_RGB;
         }
 
-        void set_size(vec2 newSize) {
+        void set_size(vec2 newSize) {
+            size = newSize;
+            surface = Surface(newSize, Surface::alignedPitch((int)newSize.x));
+
+            SetWindowPos(
+                handle,
+                nullptr,
+                0, 0,
+                (int)newSize.x,
+                (int)newSize.y,
+                SWP_NOMOVE | SWP_NOZORDER
+            );
+
+            configure_bitmap();
+        }
+
+        void set_title(std::string newTitle) {
+            title = newTitle;
+            std::wstring wideTitle = utf8::widen(newTitle);
+            SetWindowTextW(handle, wideTitle.c_str());
+        }
+
+        void flip() {
+            WINHELP_PROFILE_SCOPE("display::flip");
+            if (!handle) return;
+            HDC dc = GetDC(handle);
+
+            StretchDIBits(
+                dc,
+                0, 0,
+                (int)size.x,
+                (int)size.y,
+                0, 0,
+                (int)size.x,
+                (int)size.y,
+                surface.pixels.data(),
+                &bitmapInfo,
+                DIB_RGB_COLORS,
+                SRCCOPY
+            );
+
+            ReleaseDC(handle, dc);
+        }
+
+        void close() {
+            DestroyWindow(handle);
+            handle = nullptr;
+        }
+    };
+#endif
+
+    namespace draw {
+
+        inline uint32_t pack_colour(vec3 c, uint8_t a = 255) {
+            return (uint32_t(a) << 24) |
+                (uint32_t(c.x) << 16) |
+                (uint32_t(c.y) << 8)  |
+                uint32_t(c.z);
+        }
+
+        inline void put_pixel(SurfaceView surface, int x, int y, vec3 colour) {
+            irect clip = surface.clipRect();
+            if (x < clip.x0 || y < clip.y0 || x >= clip.x1 || y >= clip.y1)
+                return;
+
+            surface.row(y)[x] =
+                pack_colour(colour);
+        }
+
+        // src over dst, src is straight (not premultiplied) ARGB
+        inline uint32_t blend_pixel(uint32_t dst, uint32_t src) {
+            uint32_t srcA = src >> 24;
+
+            if (srcA == 255)
+                return src;
+
+            if (srcA == 0)
+                return dst;
+
+            uint32_t dstRB = dst & 0x00FF00FF;
+            uint32_t dstG  = dst & 0x0000FF00;
+
+            uint32_t srcRB = src & 0x00FF00FF;
+            uint32_t srcG  = src & 0x0000FF00;
+
+            uint32_t invA = 255 - srcA;
+
+            // multiply packed channels
+            dstRB = (dstRB * invA) >> 8;
+            dstG  = (dstG  * invA) >> 8;
+
+            srcRB = (srcRB * srcA) >> 8;
+            srcG  = (srcG  * srcA) >> 8;
+
+            uint32_t outRB = (srcRB + dstRB) & 0x00FF00FF;
+            uint32_t outG  = (srcG  + dstG ) & 0x0000FF00;
+
+            return 0xFF000000 | outRB | outG;
+        }
+
+        // Alpha blended pixel write (for font blitting etc.)
+        inline void put_pixel_alpha(SurfaceView surface, int x, int y, uint32_t src) {
+            irect clip = surface.clipRect();
+            if (x < clip.x0 || y < clip.y0 || x >= clip.x1 || y >= clip.y1)
+                return;
+
+            uint32_t& dst = surface.row(y)[x];
+            dst = blend_pixel(dst, src);
+        }
+
+        inline void blit(SurfaceView target, const SourceView& source, vec2 position, bool blend = true) {
+            target.blit(position, source, blend);
+        }
+
+        inline void blit(SurfaceView target, const SourceView& source, vec2 position, blend_mode mode, int opacity = 255) {
+            target.blit(position, source, mode, opacity);
+        }
+
+        namespace internal_mask {
+            // size coverage bytes, rows pitch apart, with their top left at `at`
+            inline void blit(SurfaceView& target, const uint8_t* pixels, int pitch, ivec2 size, ivec2 at,
+                uint32_t packed, uint32_t alpha, internal_blend::mask_fn maskRow) {
+
+                irect area = irect(at.x, at.y, at.x + size.x, at.y + size.y).intersect(target.clipRect());
+
+                for (int y = area.y0; y < area.y1; ++y)
+                    maskRow(target.row(y) + area.x0, pixels + (size_t)(y - at.y) * pitch + (area.x0 - at.x),
+                        area.x1 - area.x0, packed, alpha);
+            }
+        }
+
+        // mask at position in one colour, colour.w scaling every coverage value.
+        // Recolouring costs nothing, it is the same mask.
+        inline void blit_mask(SurfaceView target, const MaskSurface& mask, vec2 position, vec4 colour,
+            blend_mode mode = blend_mode::alpha) {
+
+            WINHELP_PROFILE_SCOPE("draw::blit_mask");
+
+            uint32_t alpha = (uint32_t)std::clamp(colour.w, 0.0f, 255.0f);
+            if (alpha == 0)
+                return;
+
+            internal_mask::blit(target, mask.pixels.data(), mask.pitch, mask.size,
+                { (int)position.x, (int)position.y }, pack_colour(vec3(colour)), alpha,
+                internal_blend::pick_mask(mode));
+        }
+
+        // an RleSurface like any other source, same result as blitting the
+        // Surface it was made from
+        inline void blit(SurfaceView target, const RleSurface& source, vec2 position,
+            blend_mode mode = blend_mode::alpha, int opacity = 255) {
+
+            WINHELP_PROFILE_SCOPE("draw::blit_rle");
+
+            int px = (int)position.x;
+            int py = (int)position.y;
+            irect area = irect(px, py, px + source.size.x, py + source.size.y).intersect(target.clipRect());
+            opacity = std::clamp(opacity, 0, 255);
+
+            if (area.empty() || opacity == 0)
+                return;
+
+            // solid runs are a memcpy unless something has to be done to them
+            internal_blend::row_fn solid = mode == blend_mode::alpha && opacity == 255 ? nullptr :
+                internal_blend::pick(mode, false, (uint32_t)opacity);
+            internal_blend::row_fn blended = internal_blend::pick(mode, true, (uint32_t)opacity);
+
+            for (int y = area.y0; y < area.y1; ++y) {
+                const uint32_t* run = source.data.data() + source.rows[y - py];
+                const uint32_t* end = source.data.data() + source.rows[y - py + 1];
+                uint32_t* dst = target.row(y);
+
+                for (int x = px; run < end && x < area.x1; ) {
+                    uint32_t kind = *run >> 30;
+                    int length = (int)(*run & 0x3FFFFFFF);
+                    ++run;
+
+                    if (kind != RleSurface::skip) {
+                        int from = std::max(x, area.x0);
+                        int to = std::min(x + length, area.x1);
+
+                        if (from < to) {
+                            const uint32_t* src = run + (from - x);
+                            if (kind == RleSurface::translucent)
+                                blended(dst + from, src, to - from, (uint32_t)opacity);
+                            else if (solid)
+                                solid(dst + from, src, to - from, (uint32_t)opacity);
+                            else
+                                memcpy(dst + from, src, (to - from) * sizeof(uint32_t));
+                        }
+
+                        run += length;
+                    }
+
+                    x += length;
+                }
+            }
+        }
+
+        // how blit_scaled picks source pixels
+        enum class filter {
+            nearest,  // blocky, right for pixel art and integer scales
+            bilinear, // smooth, for growing or shrinking by less than 2x
+            box       // average of all the source pixels under each target one, for shrinking a lot
+        };
+
+        namespace internal_scale {
+            // (a * (256 - f) + b * f) / 256 per channel, f 0..255
+            inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t f) {
+                uint32_t g = 256 - f;
+                uint32_t rb = ((a & 0x00FF00FF) * g + (b & 0x00FF00FF) * f + 0x00800080) >> 8;
+                uint32_t ag = ((a >> 8) & 0x00FF00FF) * g + ((b >> 8) & 0x00FF00FF) * f + 0x00800080;
+                return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+            }
+
+            // the same between two whole rows
+            inline void lerp_rows(uint32_t* out, const uint32_t* a, const uint32_t* b, int count, uint32_t f) {
+                int x = 0;
+
+#ifdef WINHELP_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i fb = _mm_set1_epi16((short)f);
+                const __m128i fa = _mm_set1_epi16((short)(256 - f));
+                const __m128i half = _mm_set1_epi16(128);
+
+                for (; x + 4 <= count; x += 4) {
+                    __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+                    __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+
+                    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), fa),
+                        _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), fb));
+                    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), fa),
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), fb));
+
+                    lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+                    hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+                    _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+                }
+#endif
+
+                for (; x < count; ++x)
+                    out[x] = lerp(a[x], b[x], f);
+            }
+
+            // source pixels (16.16) per target pixel
+            inline int64_t step(int srcLen, int dstLen) {
+                return ((int64_t)srcLen << 16) / dstLen;
+            }
+
+            // where (16.16) the centre of target pixel `from` lands in the source.
+            // bias moves it back half a pixel for bilinear, which measures from
+            // source pixel centres.
+            inline int64_t start(int64_t stepSize, int from, bool bias) {
+                return stepSize / 2 + stepSize * from - (bias ? 0x8000 : 0);
+            }
+
+            // Each target row: out points at the target itself when it is a
+            // straight copy, or at a scratch row that gets blended on after.
+            template <typename Produce>
+            inline void rows(SurfaceView& target, const irect& area, internal_blend::row_fn blendRow,
+                uint32_t opacity, Produce produce) {
+
+                thread_local std::vector<uint32_t> scratch;
+                int count = area.x1 - area.x0;
+
+                if (!blendRow) {
+                    for (int y = area.y0; y < area.y1; ++y)
+                        produce(y, target.row(y) + area.x0);
+                    return;
+                }
+
+                scratch.resize(count);
+                for (int y = area.y0; y < area.y1; ++y) {
+                    produce(y, scratch.data());
+                    blendRow(target.row(y) + area.x0, scratch.data(), count, opacity);
+                }
+            }
+        }
+
+        // source stretched to cover position/size of target. Blends like blit
+        // (mode and opacity), so a plain opaque copy writes straight through.
+        inline void blit_scaled(SurfaceView target, const SourceView& source, vec2 position, vec2 size,
+            filter sampling = filter::bilinear, blend_mode mode = blend_mode::alpha, int opacity = 255) {
+
+            WINHELP_PROFILE_SCOPE("draw::blit_scaled");
+
+            int dx = (int)position.x;
+            int dy = (int)position.y;
+            int dw = (int)size.x;
+            int dh = (int)size.y;
+            int sw = source.size.x;
+            int sh = source.size.y;
+
+            if (dw <= 0 || dh <= 0 || sw <= 0 || sh <= 0)
+                return;
+
+            if (dw == sw && dh == sh) {
+                target.blit(position, source, mode, opacity);
+                return;
+            }
+
+            irect area = irect(dx, dy, dx + dw, dy + dh).intersect(target.clipRect());
+            opacity = std::clamp(opacity, 0, 255);
+
+            if (area.empty() || opacity == 0)
+                return;
+
+            bool copy = mode == blend_mode::alpha && opacity == 255 && !source.hasAlpha;
+            internal_blend::row_fn blendRow = copy ? nullptr :
+                internal_blend::pick(mode, source.hasAlpha, (uint32_t)opacity);
+
+            int count = area.x1 - area.x0;
+            int64_t stepX = internal_scale::step(sw, dw);
+            int64_t stepY = internal_scale::step(sh, dh);
+
+            if (sampling == filter::nearest) {
+                thread_local std::vector<int> cols;
+                cols.resize(count);
+
+                int64_t u = internal_scale::start(stepX, area.x0 - dx, false);
+                for (int i = 0; i < count; ++i, u += stepX)
+                    cols[i] = std::min((int)(u >> 16), sw - 1);
+
+                int64_t v = internal_scale::start(stepY, area.y0 - dy, false);
+                internal_scale::rows(target, area, blendRow, (uint32_t)opacity, [&](int, uint32_t* out) {
+                    const uint32_t* src = source.row(std::min((int)(v >> 16), sh - 1));
+                    v += stepY;
+
+                    const int* col = cols.data();
+                    for (int i = 0; i < count; ++i)
+                        out[i] = src[col[i]];
+                });
+                return;
+            }
+
+            if (sampling == filter::bilinear) {
+                // per column: left source pixel, and the weights of it and the
+                // one after it as two 16 bit halves
+                thread_local std::vector<int> cols;
+                thread_local std::vector<uint32_t> weights;
+                thread_local std::vector<uint32_t> between; // the two source rows blended vertically
+                cols.resize(count);
+                weights.resize(count);
+                between.resize((size_t)sw + 1);
+
+                int64_t u = internal_scale::start(stepX, area.x0 - dx, true);
+                for (int i = 0; i < count; ++i, u += stepX) {
+                    int64_t c = std::max<int64_t>(u, 0);
+                    int x0 = (int)(c >> 16);
+                    cols[i] = std::min(x0, sw - 1);
+                    uint32_t f = x0 >= sw - 1 ? 0 : (uint32_t)(c >> 8) & 0xFF;
+                    weights[i] = (256 - f) | (f << 16);
+                }
+
+                int lo = cols[0];
+                int hi = std::min(cols[count - 1] + 1, sw - 1);
+                int lastRow = -1;
+                uint32_t lastWeight = 0;
+
+                int64_t v = internal_scale::start(stepY, area.y0 - dy, true);
+                internal_scale::rows(target, area, blendRow, (uint32_t)opacity, [&](int, uint32_t* out) {
+                    int64_t c = std::max<int64_t>(v, 0);
+                    v += stepY;
+
+                    int y0 = std::min((int)(c >> 16), sh - 1);
+                    uint32_t fy = y0 >= sh - 1 ? 0 : (uint32_t)(c >> 8) & 0xFF;
+
+                    // growing, neighbouring rows often share the same pair
+                    if (y0 != lastRow || fy != lastWeight) {
+                        internal_scale::lerp_rows(between.data() + lo, source.row(y0) + lo,
+                            source.row(std::min(y0 + 1, sh - 1)) + lo, hi - lo + 1, fy);
+                        between[sw] = between[sw - 1];
+                        lastRow = y0;
+                        lastWeight = fy;
+                    }
+
+                    const uint32_t* row = between.data();
+                    const int* col = cols.data();
+                    const uint32_t* weight = weights.data();
+                    int i = 0;
+#ifdef WINHELP_SSE2
+                    const __m128i zero = _mm_setzero_si128();
+                    const __m128i half = _mm_set1_epi16(128);
+                    for (; i < count; ++i) {
+                        __m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + col[i])), zero);
+                        __m128i w = _mm_cvtsi32_si128((int)weight[i]);
+                        w = _mm_unpacklo_epi32(_mm_unpacklo_epi16(w, w), _mm_unpacklo_epi16(w, w));
+                        __m128i m = _mm_mullo_epi16(pair, w);
+                        m = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(m, _mm_srli_si128(m, 8)), half), 8);
+                        out[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(m, m));
+                    }
+#endif
+                    for (; i < count; ++i)
+                        out[i] = internal_scale::lerp(row[col[i]], row[col[i] + 1], weight[i] >> 16);
+                });
+                return;
+            }
+
+            // box: every target pixel gets the mean of the whole source rect under
+            // it. Source rows are summed per column once, then columns per pixel.
+            thread_local std::vector<int> spans;      // first source column per target column, + end
+            thread_local std::vector<uint32_t> sums;  // b, g, r, a per source column
+            spans.resize(count + 1);
+
+            for (int i = 0; i <= count; ++i)
+                spans[i] = (int)(((int64_t)(area.x0 - dx + i) * sw) / dw);
+
+            int lo = spans[0];
+            int hi = std::max(spans[count], spans[count - 1] + 1);
+            sums.resize((size_t)(hi - lo) * 4);
+
+            internal_scale::rows(target, area, blendRow, (uint32_t)opacity, [&](int y, uint32_t* out) {
+                int r0 = (int)(((int64_t)(y - dy) * sh) / dh);
+                int r1 = std::max(r0 + 1, (int)(((int64_t)(y - dy + 1) * sh) / dh));
+
+                std::fill(sums.begin(), sums.end(), 0u);
+                for (int sy = r0; sy < r1; ++sy) {
+                    const uint32_t* src = source.row(sy) + lo;
+                    uint32_t* sum = sums.data();
+                    int x = 0;
+
+#ifdef WINHELP_SSE2
+                    const __m128i zero = _mm_setzero_si128();
+                    for (; x + 4 <= hi - lo; x += 4) {
+                        __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+                        __m128i lo16 = _mm_unpacklo_epi8(p, zero);
+                        __m128i hi16 = _mm_unpackhi_epi8(p, zero);
+                        __m128i* s = (__m128i*)(sum + x * 4);
+
+                        _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo16, zero)));
+                        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo16, zero)));
+                        _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi16, zero)));
+                        _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi16, zero)));
+                    }
+#endif
+
+                    for (; x < hi - lo; ++x) {
+                        uint32_t p = src[x];
+                        sum[x * 4 + 0] += p & 0xFF;
+                        sum[x * 4 + 1] += (p >> 8) & 0xFF;
+                        sum[x * 4 + 2] += (p >> 16) & 0xFF;
+                        sum[x * 4 + 3] += p >> 24;
+                    }
+                }
+
+                for (int i = 0; i < count; ++i) {
+                    int c0 = spans[i] - lo;
+                    int c1 = std::max(spans[i + 1], spans[i] + 1) - lo;
+
+                    uint32_t total[4] = { 0, 0, 0, 0 };
+                    for (int c = c0; c < c1; ++c)
+                        for (int k = 0; k < 4; ++k)
+                            total[k] += sums[(size_t)c * 4 + k];
+
+                    // divide by the pixel count as a 32.32 multiply
+                    uint64_t n = (uint64_t)(c1 - c0) * (r1 - r0);
+                    uint64_t inverse = ((1ull << 32) + n / 2) / n;
+
+                    uint32_t pixel = 0;
+                    for (int k = 0; k < 4; ++k)
+                        pixel |= (uint32_t)std::min<uint64_t>(255, (total[k] * inverse + (1ull << 31)) >> 32) << (k * 8);
+                    out[i] = pixel;
+                }
+            });
+        }
+
+        namespace internal_scale {
+            // Cuts [x0, x1) down to the target pixels whose centres map (u = du *
+            // (x + 0.5) + base) into [0, limit). Loose by a pixel each side, the
+            // caller trims the ends exactly in fixed point.
+            inline void span(double du, double base, double limit, int& x0, int& x1) {
+                if (du == 0) {
+                    if (base < 0 || base >= limit)
+                        x1 = x0;
+                    return;
+                }
+
+                double lo = -base / du - 0.5;
+                double hi = (limit - base) / du - 0.5;
+                if (lo > hi)
+                    std::swap(lo, hi);
+
+                lo = std::max(lo, (double)x0 - 1);
+                hi = std::min(hi, (double)x1 + 1);
+                x0 = std::max(x0, (int)std::floor(lo) - 1);
+                x1 = std::min(x1, (int)std::ceil(hi) + 2);
+            }
+
+            // count pixels stepping through source from (u, v), 16.16
+            inline void nearest_span(uint32_t* out, const SourceView& source,
+                int64_t u, int64_t v, int64_t du, int64_t dv, int count) {
+
+                for (int i = 0; i < count; ++i, u += du, v += dv)
+                    out[i] = source.row((int)(v >> 16))[u >> 16];
+            }
+
+            // the same between pixel centres (u, v already moved back half a
+            // pixel), edges clamped so the border pixels never read outside
+            inline void bilinear_span(uint32_t* out, const SourceView& source,
+                int64_t u, int64_t v, int64_t du, int64_t dv, int count) {
+
+                int lastX = source.size.x - 1;
+                int lastY = source.size.y - 1;
+
+#ifdef WINHELP_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i half = _mm_set1_epi16(128);
+                const __m128i full = _mm_set1_epi16(256);
+#endif
+
+                for (int i = 0; i < count; ++i, u += du, v += dv) {
+                    int x = (int)(u >> 16);
+                    int y = (int)(v >> 16);
+                    uint32_t fx = (uint32_t)(u >> 8) & 0xFF;
+                    uint32_t fy = (uint32_t)(v >> 8) & 0xFF;
+
+                    int xa = std::max(x, 0), xb = std::min(x + 1, lastX);
+                    const uint32_t* top = source.row(std::max(y, 0));
+                    const uint32_t* bottom = source.row(std::min(y + 1, lastY));
+
+#ifdef WINHELP_SSE2
+                    // top pair and bottom pair, 16 bit lanes: rows first, then across
+                    __m128i quad = _mm_set_epi32((int)bottom[xb], (int)bottom[xa], (int)top[xb], (int)top[xa]);
+                    __m128i wy = _mm_set1_epi16((short)fy);
+                    __m128i wx = _mm_unpacklo_epi64(_mm_sub_epi16(full, _mm_set1_epi16((short)fx)), _mm_set1_epi16((short)fx));
+
+                    __m128i rows = _mm_add_epi16(
+                        _mm_mullo_epi16(_mm_unpacklo_epi8(quad, zero), _mm_sub_epi16(full, wy)),
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(quad, zero), wy));
+                    rows = _mm_srli_epi16(_mm_add_epi16(rows, half), 8);
+
+                    __m128i across = _mm_mullo_epi16(rows, wx);
+                    across = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(across, _mm_srli_si128(across, 8)), half), 8);
+                    out[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(across, across));
+#else
+                    out[i] = lerp(lerp(top[xa], bottom[xa], fy), lerp(top[xb], bottom[xb], fy), fx);
+#endif
+                }
+            }
+        }
+
+        // source drawn through transform (source pixels -> target pixels), so a
+        // rotated, scaled or sheared sprite needs no pre-rendered copy. Each
+        // target row maps back to one straight run through the source. Blends
+        // like blit; filter::box samples as bilinear here.
+        inline void blit_transformed(SurfaceView target, const SourceView& source, const mat2x3& transform,
+            filter sampling = filter::bilinear, blend_mode mode = blend_mode::alpha, int opacity = 255) {
+
+            WINHELP_PROFILE_SCOPE("draw::blit_transformed");
+
+            int sw = source.size.x;
+            int sh = source.size.y;
+            opacity = std::clamp(opacity, 0, 255);
+
+            if (sw <= 0 || sh <= 0 || opacity == 0 || transform.determinant() == 0)
+                return;
+
+            // bounding box of the transformed source, cut to the clip
+            irect clip = target.clipRect();
+            vec2 corners[4] = {
+                transform * vec2(0, 0), transform * vec2((float)sw, 0),
+                transform * vec2(0, (float)sh), transform * vec2((float)sw, (float)sh)
+            };
+
+            float minX = corners[0].x, maxX = corners[0].x;
+            float minY = corners[0].y, maxY = corners[0].y;
+            for (const vec2& p : corners) {
+                minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+                minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+            }
+
+            irect area = irect(
+                (int)std::floor(std::max(minX, (float)clip.x0)), (int)std::floor(std::max(minY, (float)clip.y0)),
+                (int)std::ceil(std::min(maxX, (float)clip.x1)), (int)std::ceil(std::min(maxY, (float)clip.y1))
+            ).intersect(clip);
+
+            if (area.empty())
+                return;
+
+            mat2x3 inv = transform.inverse();
+            bool smooth = sampling != filter::nearest;
+            bool copy = mode == blend_mode::alpha && opacity == 255 && !source.hasAlpha;
+            internal_blend::row_fn blendRow = copy ? nullptr :
+                internal_blend::pick(mode, source.hasAlpha, (uint32_t)opacity);
+
+            thread_local std::vector<uint32_t> scratch;
+            scratch.resize(area.x1 - area.x0);
+
+            int64_t du = std::llround(inv.a * 65536.0);
+            int64_t dv = std::llround(inv.c * 65536.0);
+            int64_t uEnd = (int64_t)sw << 16;
+            int64_t vEnd = (int64_t)sh << 16;
+
+            for (int y = area.y0; y < area.y1; ++y) {
+                double py = y + 0.5;
+                int x0 = area.x0;
+                int x1 = area.x1;
+
+                internal_scale::span(inv.a, inv.b * py + inv.tx, sw, x0, x1);
+                internal_scale::span(inv.c, inv.d * py + inv.ty, sh, x0, x1);
+                if (x0 >= x1)
+                    continue;
+
+                // where the first centre lands, then both ends trimmed to what the
+                // stepping really puts inside the source. The run in between is
+                // straight so everything in it is inside too.
+                int64_t u = std::llround((inv.a * (x0 + 0.5) + inv.b * py + inv.tx) * 65536.0);
+                int64_t v = std::llround((inv.c * (x0 + 0.5) + inv.d * py + inv.ty) * 65536.0);
+
+                auto inside = [&](int k) {
+                    int64_t uk = u + du * k;
+                    int64_t vk = v + dv * k;
+                    return uk >= 0 && uk < uEnd && vk >= 0 && vk < vEnd;
+                };
+
+                int first = 0;
+                int end = x1 - x0;
+                while (first < end && !inside(first))
+                    ++first;
+                while (end > first && !inside(end - 1))
+                    --end;
+                if (first >= end)
+                    continue;
+
+                x0 += first;
+                u += du * first;
+                v += dv * first;
+                int count = end - first;
+
+                uint32_t* out = copy ? target.row(y) + x0 : scratch.data();
+                if (smooth)
+                    internal_scale::bilinear_span(out, source, u - 0x8000, v - 0x8000, du, dv, count);
+                else
+                    internal_scale::nearest_span(out, source, u, v, du, dv, count);
+
+                if (!copy)
+                    blendRow(target.row(y) + x0, out, count, (uint32_t)opacity);
+            }
+        }
+
+        // how the ends of a thick line look
+        enum class cap {
+            butt,   // stops exactly at the end point
+            square, // extends half the thickness past the end point
+            round   // half circle around the end point
+        };
+
+        namespace internal_raster {
+            // A thick line as a convex shape: a box around the segment (butt / square
+            // caps) or a capsule (round caps). Pixel centres sit on integer coordinates,
+            // the same as the 1px Bresenham line.
+            struct Stroke {
+                vec2 a, b;
+                vec2 centre;
+                vec2 u, n;        // unit direction and normal
+                float halfLength; // along u, square caps included (box only)
+                float halfWidth;
+                bool round;
+
+                Stroke(vec2 start, vec2 end, float thickness, cap lineCap)
+                    : a(start), b(end), centre((start + end) * 0.5f),
+                    halfWidth(thickness * 0.5f), round(lineCap == cap::round) {
+
+                    vec2 d = end - start;
+                    float length = std::sqrt(d.x * d.x + d.y * d.y);
+
+                    u = length > 1e-6f ? d * (1.0f / length) : vec2(1, 0);
+                    n = { -u.y, u.x };
+
+                    halfLength = length * 0.5f;
+                    if (lineCap == cap::square)
+                        halfLength += halfWidth;
+                }
+
+                // x range where |(p - origin) . axis| <= k on row y
+                static bool slab(vec2 origin, vec2 axis, float k, float y, float& lo, float& hi) {
+                    if (k < 0)
+                        return false;
+
+                    float s = (y - origin.y) * axis.y;
+
+                    if (std::abs(axis.x) < 1e-6f) {
+                        lo = -1e30f;
+                        hi = 1e30f;
+                        return std::abs(s) <= k;
+                    }
+
+                    float inv = 1.0f / axis.x;
+                    float x0 = origin.x + (-k - s) * inv;
+                    float x1 = origin.x + ( k - s) * inv;
+                    lo = std::min(x0, x1);
+                    hi = std::max(x0, x1);
+                    return true;
+                }
+
+                static bool disc(vec2 c, float r, float y, float& lo, float& hi) {
+                    float dy = y - c.y;
+                    float h = r * r - dy * dy;
+                    if (r < 0 || h < 0)
+                        return false;
+
+                    h = std::sqrt(h);
+                    lo = c.x - h;
+                    hi = c.x + h;
+                    return true;
+                }
+
+                // x range of row y inside the shape grown (or shrunk, grow < 0) by grow
+                bool span(float y, float grow, float& lo, float& hi) const {
+                    float l0, h0, l1, h1;
+
+                    if (!round) {
+                        if (!slab(centre, u, halfLength + grow, y, l0, h0) ||
+                            !slab(centre, n, halfWidth + grow, y, l1, h1))
+                            return false;
+
+                        lo = std::max(l0, l1);
+                        hi = std::min(h0, h1);
+                        return lo <= hi;
+                    }
+
+                    // the capsule is convex, so the union of its parts is one range
+                    float r = halfWidth + grow;
+                    bool any = false;
+                    lo = 1e30f;
+                    hi = -1e30f;
+
+                    if (slab(centre, u, halfLength, y, l0, h0) &&
+                        slab(centre, n, r, y, l1, h1) &&
+                        std::max(l0, l1) <= std::min(h0, h1)) {
+                        lo = std::max(l0, l1);
+                        hi = std::min(h0, h1);
+                        any = true;
+                    }
+
+                    for (vec2 end : { a, b }) {
+                        if (disc(end, r, y, l0, h0)) {
+                            lo = std::min(lo, l0);
+                            hi = std::max(hi, h0);
+                            any = true;
+                        }
+                    }
+
+                    return any;
+                }
+
+                // signed distance to the edge, negative inside
+                float distance(float x, float y) const {
+                    vec2 p = vec2(x, y) - centre;
+                    float t = p.x * u.x + p.y * u.y;
+                    float d = p.x * n.x + p.y * n.y;
+
+                    if (!round)
+                        return std::max(std::abs(t) - halfLength, std::abs(d) - halfWidth);
+
+                    t = std::max(0.0f, std::abs(t) - halfLength);
+                    return std::sqrt(t * t + d * d) - halfWidth;
+                }
+
+                void rows(float grow, const irect& clip, int& first, int& last) const {
+                    float extent = halfLength * std::abs(u.y) +
+                                   (round ? halfWidth : halfWidth * std::abs(n.y)) + grow;
+                    first = std::max(clip.y0, (int)std::floor(centre.y - extent));
+                    last  = std::min(clip.y1 - 1, (int)std::ceil(centre.y + extent));
+                }
+            };
+        }
+
+        // Xiaolin Wu anti aliased 1px line
+        inline void line_wu(SurfaceView surface, vec2 start, vec2 end, vec3 colour) {
+            uint32_t rgb = pack_colour(colour, 0);
+            irect clip = surface.clipRect();
+
+            // the minor axis still needs a check, the major one is cut below
+            auto plot = [&](int x, int y, float coverage) {
+                if (x < clip.x0 || y < clip.y0 || x >= clip.x1 || y >= clip.y1)
+                    return;
+
+                uint32_t a = (uint32_t)(coverage * 255.0f + 0.5f);
+                uint32_t& dst = surface.row(y)[x];
+                dst = blend_pixel(dst, (std::min(a, 255u) << 24) | rgb);
+            };
+
+            float x0 = start.x, y0 = start.y;
+            float x1 = end.x,   y1 = end.y;
+
+            bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+            if (steep) {
+                std::swap(x0, y0);
+                std::swap(x1, y1);
+            }
+            if (x0 > x1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+            }
+
+            float dx = x1 - x0;
+            float gradient = dx < 1e-6f ? 1.0f : (y1 - y0) / dx;
+
+            auto plot2 = [&](int major, float minor, float weight) {
+                int m = (int)std::floor(minor);
+                float f = minor - m;
+                if (steep) {
+                    plot(m,     major, (1 - f) * weight);
+                    plot(m + 1, major, f * weight);
+                } else {
+                    plot(major, m,     (1 - f) * weight);
+                    plot(major, m + 1, f * weight);
+                }
+            };
+
+            // end points get partial coverage along the major axis
+            int xStart = (int)std::round(x0);
+            float yStart = y0 + gradient * (xStart - x0);
+            plot2(xStart, yStart, 1.0f - (x0 + 0.5f - std::floor(x0 + 0.5f)));
+
+            int xEnd = (int)std::round(x1);
+            float yEnd = y1 + gradient * (xEnd - x1);
+            plot2(xEnd, yEnd, x1 + 0.5f - std::floor(x1 + 0.5f));
+
+            // only walk the part of the major axis that is on screen
+            int first = std::max(xStart + 1, steep ? clip.y0 : clip.x0);
+            int last  = std::min(xEnd - 1, (steep ? clip.y1 : clip.x1) - 1);
+
+            float y = yStart + gradient * (first - xStart);
+            for (int x = first; x <= last; ++x) {
+                plot2(x, y, 1.0f);
+                y += gradient;
+            }
+        }
+
+        // Anti aliased line, Wu's algorithm at 1px and analytic edge coverage
+        // for thick lines (only the edge pixels are blended, the inside is a span fill)
+        inline void line_aa(SurfaceView surface, vec2 start, vec2 end,
+                        vec3 colour, float thickness = 1.0f,
+                        cap lineCap = cap::butt) {
+            WINHELP_PROFILE_SCOPE("draw::line_aa");
+
+            if (thickness <= 1.0f) {
+                line_wu(surface, start, end, colour);
+                return;
+            }
+
+            internal_raster::Stroke stroke(start, end, thickness, lineCap);
+
+            uint32_t packed = pack_colour(colour);
+            uint32_t rgb = packed & 0x00FFFFFF;
+
+            irect clip = surface.clipRect();
+
+            int firstY, lastY;
+            stroke.rows(1.0f, clip, firstY, lastY);
+
+            for (int y = firstY; y <= lastY; ++y) {
+                float lo, hi;
+                if (!stroke.span((float)y, 0.5f, lo, hi))
+                    continue;
+
+                int outerStart = std::max(clip.x0, (int)std::ceil(lo));
+                int outerEnd   = std::min(clip.x1 - 1, (int)std::floor(hi));
+
+                // fully covered part of the row
+                int innerStart = outerEnd + 1;
+                int innerEnd   = outerEnd;
+                float innerLo, innerHi;
+                if (stroke.span((float)y, -0.5f, innerLo, innerHi)) {
+                    innerStart = std::max(outerStart, (int)std::ceil(innerLo));
+                    innerEnd   = std::min(outerEnd, (int)std::floor(innerHi));
+                    if (innerStart > innerEnd) {
+                        innerStart = outerEnd + 1;
+                        innerEnd = outerEnd;
+                    }
+                }
+
+                uint32_t* row = surface.row(y);
+
+                auto edge = [&](int x) {
+                    float coverage = std::clamp(0.5f - stroke.distance((float)x, (float)y), 0.0f, 1.0f);
+                    uint32_t a = (uint32_t)(coverage * 255.0f + 0.5f);
+                    row[x] = blend_pixel(row[x], (a << 24) | rgb);
+                };
+
+                for (int x = outerStart; x < innerStart; ++x)
+                    edge(x);
+
+                for (int x = innerStart; x <= innerEnd; ++x)
+                    row[x] = packed;
+
+                for (int x = std::max(innerEnd + 1, innerStart); x <= outerEnd; ++x)
+                    edge(x);
+            }
+        }
+
+        // how two segments of a thick polyline meet
+        enum class join {
+            miter, // sharp corner, falls back to bevel past 4x the half thickness
+            round,
+            bevel
+        };
+
+        namespace internal_raster {
+            struct Span {
+                int y;
+                int startX;
+                int endX; // inclusive
+            };
+
+            // count pixels of one colour. With SSE2 the head and tail are single
+            // overlapping stores instead of scalar loops and the middle uses aligned
+            // stores, short runs (rects and circles a few pixels wide) barely branch.
+            inline void fill_row(uint32_t* dst, int count, uint32_t packed) {
+#ifdef WINHELP_SSE2
+                if (count >= 4) {
+                    __m128i v = _mm_set1_epi32((int)packed);
+                    uint32_t* end = dst + count;
+
+                    _mm_storeu_si128((__m128i*)dst, v);
+                    if (count > 8) {
+                        // from the first 16 byte boundary past dst, the head covers the gap
+                        uint32_t* p = (uint32_t*)(((uintptr_t)dst + 16) & ~(uintptr_t)15);
+                        for (; end - p >= 8; p += 8) {
+                            _mm_store_si128((__m128i*)p, v);
+                            _mm_store_si128((__m128i*)(p + 4), v);
+                        }
+                        if (end - p >= 4)
+                            _mm_store_si128((__m128i*)p, v);
+                    }
+                    // up to 8 pixels are covered by the head and this
+                    _mm_storeu_si128((__m128i*)(end - 4), v);
+                    return;
+                }
+
+                // 1 to 3 pixels, write first, middle and last
+                if (count > 0) {
+                    dst[0] = packed;
+                    dst[count >> 1] = packed;
+                    dst[count - 1] = packed;
+                }
+#else
+                while (count-- > 0)
+                    *dst++ = packed;
+#endif
+            }
+
+            // Liang-Barsky, clips a to b against [minX, maxX] x [minY, maxY]
+            // clippedStart / clippedEnd say which ends moved
+            inline bool clip_segment(vec2& a, vec2& b, float minX, float minY, float maxX, float maxY,
+                                     bool& clippedStart, bool& clippedEnd) {
+                float t0 = 0.0f, t1 = 1.0f;
+                float dx = b.x - a.x;
+                float dy = b.y - a.y;
+
+                const float p[4] = { -dx, dx, -dy, dy };
+                const float q[4] = { a.x - minX, maxX - a.x, a.y - minY, maxY - a.y };
+
+                for (int i = 0; i < 4; ++i) {
+                    if (p[i] == 0) {
+                        if (q[i] < 0) return false;
+                        continue;
+                    }
+
+                    float t = q[i] / p[i];
+                    if (p[i] < 0) {
+                        if (t > t1) return false;
+                        t0 = std::max(t0, t);
+                    } else {
+                        if (t < t0) return false;
+                        t1 = std::min(t1, t);
+                    }
+                }
+
+                clippedStart = t0 > 0;
+                clippedEnd = t1 < 1;
+
+                vec2 start = a;
+                a = { start.x + t0 * dx, start.y + t0 * dy };
+                b = { start.x + t1 * dx, start.y + t1 * dy };
+                return true;
+            }
+
+            // Bresenham between two on-surface points, no per pixel bounds checks
+            // Windowed only writes the steps inside window, so a line drawn a
+            // tile at a time lands on the same pixels as drawn whole
+            template <bool Windowed = false>
+            inline void bresenham(SurfaceView surface, int x0, int y0, int x1, int y1,
+                                  uint32_t packed, bool includeEnd, const irect& window = irect()) {
+                int dx = std::abs(x1 - x0);
+                int dy = std::abs(y1 - y0);
+                int sx = x0 < x1 ? 1 : -1;
+                int sy = y0 < y1 ? 1 : -1;
+                int err = dx - dy;
+
+                int stride = surface.pitch;
+                uint32_t* pixels = surface.pixels;
+
+                if constexpr (Windowed) {
+                    // The long axis moves every step, the short one has moved
+                    // (2 i short + long - 1) / (2 long) times by step i, the same
+                    // as the walk below. That gives the steps inside the window
+                    // on both axes, and where the walk is at the first of them.
+                    bool wide = dx >= dy;
+                    int64_t major = wide ? dx : dy, minor = wide ? dy : dx;
+                    int along = wide ? x0 : y0, across = wide ? y0 : x0;
+                    int step = wide ? sx : sy, side = wide ? sy : sx;
+                    int lo = wide ? window.x0 : window.y0, hi = (wide ? window.x1 : window.y1) - 1;
+                    int sideLo = wide ? window.y0 : window.x0, sideHi = (wide ? window.y1 : window.x1) - 1;
+
+                    int64_t first = std::max(0, step > 0 ? lo - along : along - hi);
+                    int64_t last = std::min((int64_t)(includeEnd ? major : major - 1), (int64_t)(step > 0 ? hi - along : along - lo));
+
+                    // how far the short axis may have moved to still be inside
+                    int64_t moveLo = side > 0 ? sideLo - across : across - sideHi;
+                    int64_t moveHi = side > 0 ? sideHi - across : across - sideLo;
+                    moveLo = std::max<int64_t>(moveLo, 0);
+                    if (moveHi < moveLo)
+                        return;
+                    if (minor == 0) {
+                        if (moveLo > 0)
+                            return;
+                    } else {
+                        int64_t from = 2 * major * moveLo - major + 1; // first i with 2 i minor >= it
+                        if (from > 0)
+                            first = std::max(first, (from + 2 * minor - 1) / (2 * minor));
+                        last = std::min(last, (2 * major * (moveHi + 1) - major) / (2 * minor));
+                    }
+                    if (first > last)
+                        return;
+
+                    int64_t moved = major ? (2 * first * minor + major - 1) / (2 * major) : 0;
+                    int64_t stepsX = wide ? first : moved, stepsY = wide ? moved : first;
+                    int x = x0 + sx * (int)stepsX;
+                    int y = y0 + sy * (int)stepsY;
+                    err = (int)(dx - dy - stepsX * dy + stepsY * dx);
+
+                    for (int64_t i = first; i <= last; ++i) {
+                        pixels[(size_t)y * stride + x] = packed;
+                        int e2 = 2 * err;
+                        if (e2 > -dy) { err -= dy; x += sx; }
+                        if (e2 < dx)  { err += dx; y += sy; }
+                    }
+                    return;
+                }
+
+                while (true) {
+                    bool atEnd = x0 == x1 && y0 == y1;
+
+                    if (!atEnd || includeEnd)
+                        pixels[(size_t)y0 * stride + x0] = packed;
+
+                    if (atEnd) break;
+
+                    int e2 = 2 * err;
+                    if (e2 > -dy) { err -= dy; x0 += sx; }
+                    if (e2 < dx)  { err += dx; y0 += sy; }
+                }
+            }
+
+            // clip once and walk, leaving out the end pixel unless includeEnd
+            // so a vertex shared with the next segment is only written once.
+            // Given a window only the pixels inside it are written.
+            inline void thin_segment(SurfaceView surface, const irect& clip, vec2 a, vec2 b,
+                                     uint32_t packed, bool includeEnd, const irect* window = nullptr) {
+                if (clip.empty())
+                    return;
+
+                float minX = (float)clip.x0, maxX = (float)clip.x1 - 1;
+                float minY = (float)clip.y0, maxY = (float)clip.y1 - 1;
+
+                // most segments are fully inside, skip the divides for those
+                bool clippedStart = false, clippedEnd = false;
+                bool inside = a.x >= minX && a.y >= minY && a.x <= maxX && a.y <= maxY &&
+                              b.x >= minX && b.y >= minY && b.x <= maxX && b.y <= maxY;
+
+                if (!inside && !clip_segment(a, b, minX, minY, maxX, maxY, clippedStart, clippedEnd))
+                    return;
+
+                auto px = [](float v, int lo, int hi) { return std::clamp((int)v, lo, hi - 1); };
+
+                int x0 = px(a.x, clip.x0, clip.x1), y0 = px(a.y, clip.y0, clip.y1);
+                int x1 = px(b.x, clip.x0, clip.x1), y1 = px(b.y, clip.y0, clip.y1);
+
+                if (window)
+                    bresenham<true>(surface, x0, y0, x1, y1, packed, includeEnd || clippedEnd, *window);
+                else
+                    bresenham(surface, x0, y0, x1, y1, packed, includeEnd || clippedEnd);
+            }
+
+            // x range of row y inside a convex polygon
+            inline bool convex_span(const vec2* points, int count, float y, float& lo, float& hi) {
+                lo = 1e30f;
+                hi = -1e30f;
+
+                for (int i = 0; i < count; ++i) {
+                    vec2 a = points[i];
+                    vec2 b = points[(i + 1) % count];
+                    if (a.y > b.y) std::swap(a, b);
+                    if (y < a.y || y > b.y) continue;
+
+                    if (b.y - a.y < 1e-6f) {
+                        // horizontal edge on this row, both ends count
+                        lo = std::min({ lo, a.x, b.x });
+                        hi = std::max({ hi, a.x, b.x });
+                        continue;
+                    }
+
+                    float x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+                    lo = std::min(lo, x);
+                    hi = std::max(hi, x);
+                }
+
+                return lo <= hi;
+            }
+
+            inline void add_convex(std::vector<Span>& spans, const vec2* points, int count, const irect& clip) {
+                float minY = points[0].y, maxY = points[0].y;
+                for (int i = 1; i < count; ++i) {
+                    minY = std::min(minY, points[i].y);
+                    maxY = std::max(maxY, points[i].y);
+                }
+
+                int first = std::max(clip.y0, (int)std::ceil(minY));
+                int last  = std::min(clip.y1 - 1, (int)std::floor(maxY));
+
+                for (int y = first; y <= last; ++y) {
+                    float lo, hi;
+                    if (!convex_span(points, count, (float)y, lo, hi))
+                        continue;
+
+                    int startX = std::max(clip.x0, (int)std::ceil(lo));
+                    int endX   = std::min(clip.x1 - 1, (int)std::floor(hi));
+                    if (startX <= endX)
+                        spans.push_back({ y, startX, endX });
+                }
+            }
+
+            inline void add_stroke(std::vector<Span>& spans, const Stroke& stroke, const irect& clip) {
+                int first, last;
+                stroke.rows(0, clip, first, last);
+
+                for (int y = first; y <= last; ++y) {
+                    float lo, hi;
+                    if (!stroke.span((float)y, 0, lo, hi))
+                        continue;
+
+                    int startX = std::max(clip.x0, (int)std::ceil(lo));
+                    int endX   = std::min(clip.x1 - 1, (int)std::floor(hi));
+                    if (startX <= endX)
+                        spans.push_back({ y, startX, endX });
+                }
+            }
+
+            // the corner piece between two segments meeting at p
+            inline void add_join(std::vector<Span>& spans, vec2 p, vec2 u0, vec2 u1,
+                                 float halfWidth, join lineJoin, const irect& clip) {
+                float cross = u0.x * u1.y - u0.y * u1.x;
+                float dot = u0.x * u1.x + u0.y * u1.y;
+
+                if (std::abs(cross) < 1e-6f && dot > 0)
+                    return; // straight on, the segments already meet
+
+                if (lineJoin == join::round) {
+                    add_stroke(spans, Stroke(p, p, halfWidth * 2, cap::round), clip);
+                    return;
+                }
+
+                // the gap is on the outside of the turn
+                float side = cross > 0 ? -1.0f : 1.0f;
+                vec2 n0 = vec2(-u0.y, u0.x) * side;
+                vec2 n1 = vec2(-u1.y, u1.x) * side;
+                vec2 a = p + n0 * halfWidth;
+                vec2 b = p + n1 * halfWidth;
+
+                if (lineJoin == join::miter) {
+                    vec2 m = n0 + n1;
+                    float length = std::sqrt(m.x * m.x + m.y * m.y);
+                    if (length > 1e-6f) {
+                        m = m * (1.0f / length);
+                        float cosHalf = m.x * n0.x + m.y * n0.y;
+                        if (cosHalf > 0.25f) {
+                            vec2 quad[4] = { p, a, p + m * (halfWidth / cosHalf), b };
+                            add_convex(spans, quad, 4, clip);
+                            return;
+                        }
+                    }
+                }
+
+                vec2 triangle[3] = { p, a, b };
+                add_convex(spans, triangle, 3, clip);
+            }
+
+            inline std::vector<Span>& scratch_spans() {
+                thread_local std::vector<Span> spans;
+                return spans;
+            }
+
+            // bucket by row, merge overlapping runs and write each covered pixel once
+            inline void fill_spans(SurfaceView surface, std::vector<Span>& spans, uint32_t packed) {
+                if (spans.empty())
+                    return;
+
+                thread_local std::vector<Span> sorted;
+                thread_local std::vector<uint32_t> rowStart;
+                thread_local std::vector<int> coverage;
+
+                if (coverage.size() < (size_t)surface.size.x + 1)
+                    coverage.resize((size_t)surface.size.x + 1);
+
+                // counting sort on y, the spans are already clipped to the surface
+                rowStart.assign((size_t)surface.size.y + 1, 0);
+                for (const Span& span : spans)
+                    rowStart[span.y + 1]++;
+                for (int y = 0; y < surface.size.y; ++y)
+                    rowStart[y + 1] += rowStart[y];
+
+                sorted.resize(spans.size());
+                for (const Span& span : spans)
+                    sorted[rowStart[span.y]++] = span;
+
+                // rowStart[y] is now the end of row y
+                uint32_t begin = 0;
+                for (int y = 0; y < surface.size.y; ++y) {
+                    uint32_t end = rowStart[y];
+                    if (begin == end)
+                        continue;
+
+                    uint32_t* row = surface.row(y);
+
+                    // lots of overlapping runs (dense graphs), count coverage
+                    // along the row instead of sorting them
+                    if (end - begin > 32) {
+                        int minX = surface.size.x, maxX = 0;
+                        for (uint32_t i = begin; i < end; ++i) {
+                            minX = std::min(minX, sorted[i].startX);
+                            maxX = std::max(maxX, sorted[i].endX);
+                        }
+
+                        std::fill(coverage.begin() + minX, coverage.begin() + maxX + 2, 0);
+                        for (uint32_t i = begin; i < end; ++i) {
+                            coverage[sorted[i].startX]++;
+                            coverage[sorted[i].endX + 1]--;
+                        }
+
+                        int depth = 0;
+                        for (int x = minX; x <= maxX; ++x) {
+                            depth += coverage[x];
+                            if (depth > 0)
+                                row[x] = packed;
+                        }
+
+                        begin = end;
+                        continue;
+                    }
+
+                    std::sort(sorted.begin() + begin, sorted.begin() + end,
+                              [](const Span& a, const Span& b) { return a.startX < b.startX; });
+
+                    uint32_t i = begin;
+                    while (i < end) {
+                        int startX = sorted[i].startX;
+                        int endX = sorted[i].endX;
+
+                        for (++i; i < end && sorted[i].startX <= endX + 1; ++i)
+                            endX = std::max(endX, sorted[i].endX);
+
+                        fill_row(row + startX, endX - startX + 1, packed);
+                    }
+
+                    begin = end;
+                }
+
+                spans.clear();
+            }
+        }
+
+        inline void line(SurfaceView surface, vec2 start, vec2 end,
+                        vec3 colour, float thickness = 1.0f,
+                        cap lineCap = cap::square) {
+            WINHELP_PROFILE_SCOPE("draw::line");
+
+            uint32_t packed = pack_colour(colour);
+            irect clip = surface.clipRect();
+
+            // thick lines are one convex shape filled a span per row, so the cost is
+            // the covered area rather than thickness^2 per step
+            if (thickness > 1.0f) {
+                internal_raster::Stroke stroke(start, end, thickness, lineCap);
+
+                int firstY, lastY;
+                stroke.rows(0, clip, firstY, lastY);
+
+                for (int y = firstY; y <= lastY; ++y) {
+                    float lo, hi;
+                    if (!stroke.span((float)y, 0, lo, hi))
+                        continue;
+
+                    int startX = std::max(clip.x0, (int)std::ceil(lo));
+                    int endX   = std::min(clip.x1 - 1, (int)std::floor(hi));
+
+                    if (startX <= endX)
+                        internal_raster::fill_row(surface.row(y) + startX,
+                                                  endX - startX + 1, packed);
+                }
+                return;
+            }
+
+            // clipped once, then Bresenham with no per pixel checks
+            internal_raster::thin_segment(surface, clip, start, end, packed, true);
+        }
+
+        // Connected line through count points, each pixel is written at most once
+        // (1px: segments stop short of the shared vertex, thick: pieces are merged per row).
+        inline void polyline(SurfaceView surface, const vec2* points, size_t count,
+                        vec3 colour, float thickness = 1.0f, bool closed = false,
+                        join lineJoin = join::miter, cap lineCap = cap::butt) {
+            WINHELP_PROFILE_SCOPE("draw::polyline");
+
+            irect clip = surface.clipRect();
+            if (count == 0 || clip.empty())
+                return;
+
+            uint32_t packed = pack_colour(colour);
+
+            if (thickness <= 1.0f) {
+                if (count == 1) {
+                    internal_raster::thin_segment(surface, clip, points[0], points[0], packed, true);
+                    return;
+                }
+
+                size_t segments = closed ? count : count - 1;
+                for (size_t i = 0; i < segments; ++i) {
+                    bool last = i + 1 == segments;
+                    internal_raster::thin_segment(surface, clip, points[i], points[(i + 1) % count], packed,
+                                                  last && !closed);
+                }
+                return;
+            }
+
+            float halfWidth = thickness * 0.5f;
+            std::vector<internal_raster::Span>& spans = internal_raster::scratch_spans();
+
+            // drop repeated points, they have no direction
+            std::vector<vec2> pts;
+            pts.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                if (pts.empty() || std::abs(points[i].x - pts.back().x) > 1e-4f ||
+                                   std::abs(points[i].y - pts.back().y) > 1e-4f)
+                    pts.push_back(points[i]);
+            }
+            if (closed && pts.size() > 2 &&
+                std::abs(pts.front().x - pts.back().x) <= 1e-4f &&
+                std::abs(pts.front().y - pts.back().y) <= 1e-4f)
+                pts.pop_back();
+
+            if (pts.size() == 1) {
+                if (lineCap != cap::butt)
+                    internal_raster::add_stroke(spans, internal_raster::Stroke(pts[0], pts[0], thickness, lineCap), clip);
+                internal_raster::fill_spans(surface, spans, packed);
+                return;
+            }
+
+            size_t n = pts.size();
+            size_t segments = closed ? n : n - 1;
+
+            auto direction = [&](size_t i) {
+                vec2 d = pts[(i + 1) % n] - pts[i];
+                return d * (1.0f / std::sqrt(d.x * d.x + d.y * d.y));
+            };
+
+            for (size_t i = 0; i < segments; ++i) {
+                vec2 a = pts[i];
+                vec2 b = pts[(i + 1) % n];
+
+                // square caps only push out the two open ends
+                if (!closed && lineCap == cap::square) {
+                    vec2 u = direction(i);
+                    if (i == 0) a -= u * halfWidth;
+                    if (i + 1 == segments) b += u * halfWidth;
+                }
+
+                internal_raster::add_stroke(spans, internal_raster::Stroke(a, b, thickness, cap::butt), clip);
+            }
+
+            for (size_t i = closed ? 0 : 1; i < (closed ? n : n - 1); ++i) {
+                size_t prev = (i + n - 1) % n;
+                internal_raster::add_join(spans, pts[i], direction(prev), direction(i),
+                                          halfWidth, lineJoin, clip);
+            }
+
+            if (!closed && lineCap == cap::round) {
+                internal_raster::add_stroke(spans, internal_raster::Stroke(pts[0], pts[0], thickness, cap::round), clip);
+                internal_raster::add_stroke(spans, internal_raster::Stroke(pts[n - 1], pts[n - 1], thickness, cap::round), clip);
+            }
+
+            internal_raster::fill_spans(surface, spans, packed);
+        }
+
+        inline void polyline(SurfaceView surface, const std::vector<vec2>& points,
+                        vec3 colour, float thickness = 1.0f, bool closed = false,
+                        join lineJoin = join::miter, cap lineCap = cap::butt) {
+            polyline(surface, points.data(), points.size(), colour, thickness, closed, lineJoin, lineCap);
+        }
+
+        // Independent segments, points[0]-points[1], points[2]-points[3], ...
+        // clipped once each, thick segments are merged so overlaps are drawn once.
+        inline void line_list(SurfaceView surface, const vec2* points, size_t count,
+                        vec3 colour, float thickness = 1.0f, cap lineCap = cap::butt) {
+            WINHELP_PROFILE_SCOPE("draw::line_list");
+
+            irect clip = surface.clipRect();
+            if (clip.empty())
+                return;
+
+            uint32_t packed = pack_colour(colour);
+
+            if (thickness <= 1.0f) {
+                for (size_t i = 0; i + 1 < count; i += 2)
+                    internal_raster::thin_segment(surface, clip, points[i], points[i + 1], packed, true);
+                return;
+            }
+
+            std::vector<internal_raster::Span>& spans = internal_raster::scratch_spans();
+            for (size_t i = 0; i + 1 < count; i += 2)
+                internal_raster::add_stroke(spans, internal_raster::Stroke(points[i], points[i + 1], thickness, lineCap), clip);
+
+            internal_raster::fill_spans(surface, spans, packed);
+        }
+
+        inline void line_list(SurfaceView surface, const std::vector<vec2>& points,
+                        vec3 colour, float thickness = 1.0f, cap lineCap = cap::butt) {
+            line_list(surface, points.data(), points.size(), colour, thickness, lineCap);
+        }
+
+        inline void rect(SurfaceView surface, vec2 pos,
+                        vec2 size, vec3 colour,
+                        bool filled = true,
+                        float thickness = 1.0f) {
+            WINHELP_PROFILE_SCOPE("draw::rect");
+
+            if (not filled) {
+                line(surface, pos,
+                    { pos.x + size.x, pos.y }, colour, thickness);
+
+                line(surface,
+                    { pos.x + size.x, pos.y },
+                    { pos.x + size.x, pos.y + size.y },
+                    colour, thickness);
+
+                line(surface,
+                    { pos.x + size.x, pos.y + size.y },
+                    { pos.x, pos.y + size.y },
+                    colour, thickness);
+
+                line(surface,
+                    { pos.x, pos.y + size.y },
+                    pos, colour, thickness);
+            } else {
+                int w = (int)size.x;
+                int h = (int)size.y;
+                int px = (int)pos.x;
+                int py = (int)pos.y;
+
+                uint32_t packed = pack_colour(colour);
+                irect area = irect(px, py, px + w, py + h).intersect(surface.clipRect());
+
+                for (int y = area.y0; y < area.y1; ++y) {
+                    internal_raster::fill_row(
+                        surface.row(y) + area.x0,
+                        area.x1 - area.x0, packed);
+                }
+            }
+    }
+
+    namespace internal_raster {
+            // radii below this are kept once built, about half a megabyte per
+            // thread with all of them
+            constexpr int cachedRadius = 512;
+
+            // half widths of a circle's rows from |dy| = from on
+            struct CircleRows {
+                const int* widths;
+                int from;
+
+                int operator[](int dy) const {
+                    return widths[dy - from];
+                }
+            };
+
+            // Half width of the rows of a circle, |dy| for dy = firstY .. lastY
+            // (inside -radius .. radius). Small radii get every row built once
+            // and kept, so drawing lots of same sized circles is just span fills.
+            // Bigger ones are rare and only build the rows asked for, a huge
+            // circle through a small clip is only a few rows.
+            inline CircleRows circle_table(int radius, int firstY, int lastY) {
+                thread_local std::vector<std::vector<int>> tables;
+                thread_local std::vector<int> uncached[2];
+
+                auto build = [](std::vector<int>& table, int r, int from, int to) {
+                    table.resize((size_t)std::max(0, to - from + 1));
+                    int64_t r2 = (int64_t)r * r;
+                    for (int y = from; y <= to; ++y)
+                        table[y - from] = (int)std::sqrt((float)(r2 - (int64_t)y * y));
+                };
+
+                // two buffers so a radius and the one next to it can be used together
+                if (radius >= cachedRadius) {
+                    int from = firstY <= 0 && lastY >= 0 ? 0 : std::min(std::abs(firstY), std::abs(lastY));
+                    int to = std::min(radius, std::max(std::abs(firstY), std::abs(lastY)));
+                    build(uncached[radius & 1], radius, from, to);
+                    return { uncached[radius & 1].data(), from };
+                }
+
+                if (tables.size() <= (size_t)radius)
+                    tables.resize((size_t)radius + 1);
+
+                std::vector<int>& table = tables[radius];
+                if (table.empty())
+                    build(table, radius, 0, radius);
+
+                return { table.data(), 0 };
+            }
+
+            // Which part of each row lies inside the angle range start -> end
+            // (radians, from +x towards +y, so clockwise on screen).
+            struct Sector {
+                bool full = true;
+                bool inverted = false; // draw everything but the wedge from end -> start
+                vec2 a, b;             // wedge edge directions
+
+                Sector() {}
+
+                Sector(float startAngle, float endAngle) {
+                    const float tau = 6.28318530718f;
+                    float sweep = endAngle - startAngle;
+
+                    if (sweep >= tau || sweep <= -tau)
+                        return;
+
+                    sweep = std::fmod(sweep, tau);
+                    if (sweep < 0) sweep += tau;
+
+                    full = false;
+                    inverted = sweep > tau * 0.5f;
+
+                    float from = inverted ? endAngle : startAngle;
+                    float to   = inverted ? startAngle : endAngle;
+                    a = { std::cos(from), std::sin(from) };
+                    b = { std::cos(to),   std::sin(to) };
+                }
+
+                // k * X >= rhs as a range of X
+                static void half_plane(float k, float rhs, float& lo, float& hi) {
+                    if (k > 0)      lo = std::max(lo, rhs / k);
+                    else if (k < 0) hi = std::min(hi, rhs / k);
+                    else if (rhs > 0) { lo = 1e30f; hi = -1e30f; }
+                }
+
+                // up to two ranges of X = x - cx on row dy, returns how many
+                int ranges(float dy, float out[4]) const {
+                    if (full) {
+                        out[0] = -1e30f;
+                        out[1] = 1e30f;
+                        return 1;
+                    }
+
+                    // cross(a, p) >= 0 and cross(p, b) >= 0
+                    float lo = -1e30f, hi = 1e30f;
+                    half_plane(-a.y, -a.x * dy, lo, hi);
+                    half_plane(b.y, b.x * dy, lo, hi);
+
+                    if (!inverted) {
+                        if (lo > hi) return 0;
+                        out[0] = lo;
+                        out[1] = hi;
+                        return 1;
+                    }
+
+                    if (lo > hi) {
+                        out[0] = -1e30f;
+                        out[1] = 1e30f;
+                        return 1;
+                    }
+
+                    out[0] = -1e30f;
+                    out[1] = std::nextafter(lo, -1e30f);
+                    out[2] = std::nextafter(hi, 1e30f);
+                    out[3] = 1e30f;
+                    return 2;
+                }
+            };
+
+            // fill x in [cx + lo, cx + hi] on one row, cut to the sector and the clip
+            inline void sector_run(uint32_t* row, const irect& clip, float cx, float dy,
+                                   float lo, float hi, const Sector& sector, uint32_t packed) {
+                float ranges[4];
+                int count = sector.ranges(dy, ranges);
+
+                for (int i = 0; i < count; ++i) {
+                    float from = std::max(lo, ranges[i * 2]);
+                    float to   = std::min(hi, ranges[i * 2 + 1]);
+                    if (from > to) continue;
+
+                    int startX = std::max(clip.x0, (int)std::ceil(cx + from));
+                    int endX   = std::min(clip.x1 - 1, (int)std::floor(cx + to));
+                    if (startX <= endX)
+                        fill_row(row + startX, endX - startX + 1, packed);
+                }
+            }
+
+            // x in [cx - out, cx - from] and [cx + from, cx + out], one run when from is 0
+            inline void ring_row(uint32_t* row, const irect& clip, int cx, int from, int out, uint32_t packed) {
+                auto run = [&](int a, int b) {
+                    a = std::max(a, clip.x0);
+                    b = std::min(b, clip.x1 - 1);
+                    if (a <= b)
+                        fill_row(row + a, b - a + 1, packed);
+                };
+
+                if (from <= 0) {
+                    run(cx - out, cx + out);
+                    return;
+                }
+
+                run(cx - out, cx - from);
+                run(cx + from, cx + out);
+            }
+
+            // half width of row dy for an ellipse with radii (rx, ry), < 0 when the row misses it
+            inline float ellipse_half_width(float rx, float ry, float dy) {
+                if (rx <= 0 || ry <= 0)
+                    return -1;
+
+                float t = 1.0f - dy * dy / (ry * ry);
+                return t < 0 ? -1 : rx * std::sqrt(t);
+            }
+        }
+
+        inline void circle(SurfaceView surface, vec2 center, int radius, vec3 colour, bool filled = true) {
+            WINHELP_PROFILE_SCOPE("draw::circle");
+
+            if (radius < 0)
+                return;
+
+            int cx = (int)center.x;
+            int cy = (int)center.y;
+            irect clip = surface.clipRect();
+
+            int firstY = std::max(-radius, clip.y0 - cy);
+            int lastY  = std::min(radius, clip.y1 - 1 - cy);
+
+            // whole circle off to one side
+            if (firstY > lastY || cx + radius < clip.x0 || cx - radius >= clip.x1)
+                return;
+
+            uint32_t packed = pack_colour(colour);
+            internal_raster::CircleRows outer = internal_raster::circle_table(radius, firstY, lastY);
+
+            if (filled) {
+                for (int y = firstY; y <= lastY; ++y) {
+                    int span = outer[std::abs(y)];
+                    int startX = std::max(cx - span, clip.x0);
+                    int endX   = std::min(cx + span, clip.x1 - 1);
+
+                    if (startX <= endX)
+                        internal_raster::fill_row(surface.row(cy + y) + startX,
+                                                  endX - startX + 1, packed);
+                }
+                return;
+            }
+
+            // 1px ring: everything between this radius and the next one in,
+            // so steep parts near the top and bottom have no gaps
+            internal_raster::CircleRows inner = internal_raster::circle_table(std::max(radius - 1, 0), firstY, lastY);
+
+            for (int y = firstY; y <= lastY; ++y) {
+                int ay = std::abs(y);
+                int out = outer[ay];
+                int in = ay < radius ? inner[ay] : -1;
+
+                uint32_t* row = surface.row(cy + y);
+                internal_raster::ring_row(row, clip, cx, std::min(in + 1, out), out, packed);
+            }
+        }
+
+        inline void ellipse(SurfaceView surface, vec2 center, vec2 radii, vec3 colour, bool filled = true) {
+            WINHELP_PROFILE_SCOPE("draw::ellipse");
+
+            if (radii.x < 0 || radii.y < 0)
+                return;
+
+            int cx = (int)center.x;
+            int cy = (int)center.y;
+            int ry = (int)radii.y;
+            irect clip = surface.clipRect();
+
+            int firstY = std::max(-ry, clip.y0 - cy);
+            int lastY  = std::min(ry, clip.y1 - 1 - cy);
+
+            uint32_t packed = pack_colour(colour);
+
+            for (int y = firstY; y <= lastY; ++y) {
+                int out = std::max(0, (int)internal_raster::ellipse_half_width(radii.x, std::max(radii.y, 0.5f), (float)y));
+                int from = 0;
+
+                if (!filled) {
+                    float in = internal_raster::ellipse_half_width(radii.x - 1, radii.y - 1, (float)y);
+                    from = in < 0 ? 0 : std::min((int)in + 1, out);
+                }
+
+                uint32_t* row = surface.row(cy + y);
+                internal_raster::ring_row(row, clip, cx, from, out, packed);
+            }
+        }
+
+        // Anti aliased ellipse, filled or as a ring of the given thickness. Coverage
+        // comes from the distance to the outline, only the edge pixels are blended.
+        inline void ellipse_aa(SurfaceView surface, vec2 center, vec2 radii, vec3 colour,
+                               bool filled = true, float thickness = 1.0f) {
+            WINHELP_PROFILE_SCOPE("draw::ellipse_aa");
+
+            float rx = radii.x, ry = radii.y;
+            if (rx <= 0 || ry <= 0)
+                return;
+
+            float h = filled ? 0.0f : thickness * 0.5f;
+            float cx = center.x, cy = center.y;
+
+            uint32_t packed = pack_colour(colour);
+            uint32_t rgb = packed & 0x00FFFFFF;
+
+            // signed distance to the outline, exact for circles and the usual
+            // gradient estimate f / |grad f| for ellipses
+            auto distance = [&](float dx, float dy) {
+                float d;
+                if (rx == ry) {
+                    d = std::sqrt(dx * dx + dy * dy) - rx;
+                } else {
+                    float gx = dx / (rx * rx), gy = dy / (ry * ry);
+                    float f = dx * gx + dy * gy - 1.0f;
+                    float g = 2.0f * std::sqrt(gx * gx + gy * gy);
+                    d = g > 1e-6f ? f / g : -std::min(rx, ry);
+                }
+                return filled ? d : std::abs(d) - h;
+            };
+
+            auto half = [&](float grow, float dy) {
+                return internal_raster::ellipse_half_width(rx + grow, ry + grow, dy);
+            };
+
+            irect clip = surface.clipRect();
+            int firstY = std::max(clip.y0, (int)std::ceil(cy - ry - h - 0.5f));
+            int lastY  = std::min(clip.y1 - 1, (int)std::floor(cy + ry + h + 0.5f));
+
+            for (int y = firstY; y <= lastY; ++y) {
+                float dy = y - cy;
+
+                // bands by |x - cx|: [0, hole) empty, [hole, solidIn) edge,
+                // [solidIn, solidOut) solid, [solidOut, outer) edge
+                float outer = half(h + 0.5f, dy);
+                if (outer < 0) continue;
+
+                float solidOut = half(h - 0.5f, dy);
+                float solidIn = 0, hole = 0;
+                if (!filled) {
+                    solidIn = std::max(half(-h + 0.5f, dy), 0.0f);
+                    hole    = std::max(half(-h - 0.5f, dy), 0.0f);
+                }
+                if (solidOut < solidIn) solidOut = solidIn;
+
+                uint32_t* row = surface.row(y);
+
+                auto band = [&](float a, float b, bool solid) {
+                    if (a >= b) return;
+
+                    // right side [cx + a, cx + b), left side (cx - b, cx - a], x = cx only once
+                    int ranges[2][2] = {
+                        { (int)std::ceil(cx + a), (int)std::ceil(cx + b) - 1 },
+                        { (int)std::floor(cx - b) + 1, a == 0 ? (int)std::ceil(cx) - 1 : (int)std::floor(cx - a) }
+                    };
+
+                    for (auto& r : ranges) {
+                        int startX = std::max(r[0], clip.x0);
+                        int endX   = std::min(r[1], clip.x1 - 1);
+
+                        if (solid) {
+                            if (startX <= endX)
+                                internal_raster::fill_row(row + startX, endX - startX + 1, packed);
+                            continue;
+                        }
+
+                        for (int x = startX; x <= endX; ++x) {
+                            float coverage = std::clamp(0.5f - distance(x - cx, dy), 0.0f, 1.0f);
+                            uint32_t alpha = (uint32_t)(coverage * 255.0f + 0.5f);
+                            row[x] = blend_pixel(row[x], (alpha << 24) | rgb);
+                        }
+                    }
+                };
+
+                band(hole, solidIn, false);
+                band(solidIn, std::max(solidOut, solidIn), true);
+                band(std::max(solidOut, hole), outer, false);
+            }
+        }
+
+        inline void circle_aa(SurfaceView surface, vec2 center, float radius, vec3 colour,
+                              bool filled = true, float thickness = 1.0f) {
+            ellipse_aa(surface, center, { radius, radius }, colour, filled, thickness);
+        }
+
+        // Filled slice of a circle between two angles (radians, clockwise from +x)
+        inline void pie(SurfaceView surface, vec2 center, int radius,
+                        float startAngle, float endAngle, vec3 colour) {
+            WINHELP_PROFILE_SCOPE("draw::pie");
+
+            if (radius < 0)
+                return;
+
+            int cx = (int)center.x;
+            int cy = (int)center.y;
+            irect clip = surface.clipRect();
+            int firstY = std::max(-radius, clip.y0 - cy);
+            int lastY  = std::min(radius, clip.y1 - 1 - cy);
+
+            internal_raster::Sector sector(startAngle, endAngle);
+            internal_raster::CircleRows table = internal_raster::circle_table(radius, firstY, lastY);
+            uint32_t packed = pack_colour(colour);
+
+            for (int y = firstY; y <= lastY; ++y) {
+                float span = (float)table[std::abs(y)];
+                internal_raster::sector_run(surface.row(cy + y),
+                                            clip, (float)cx, (float)y, -span, span, sector, packed);
+            }
+        }
+
+        // Part of a circle outline between two angles (radians, clockwise from +x)
+        inline void arc(SurfaceView surface, vec2 center, int radius,
+                        float startAngle, float endAngle, vec3 colour, float thickness = 1.0f) {
+            WINHELP_PROFILE_SCOPE("draw::arc");
+
+            if (radius < 0)
+                return;
+
+            int cx = (int)center.x;
+            int cy = (int)center.y;
+            float outerR = radius + thickness * 0.5f;
+            float innerR = radius - thickness * 0.5f;
+            int reach = (int)std::ceil(outerR);
+
+            irect clip = surface.clipRect();
+            int firstY = std::max(-reach, clip.y0 - cy);
+            int lastY  = std::min(reach, clip.y1 - 1 - cy);
+
+            internal_raster::Sector sector(startAngle, endAngle);
+            uint32_t packed = pack_colour(colour);
+
+            for (int y = firstY; y <= lastY; ++y) {
+                float out = internal_raster::ellipse_half_width(outerR, outerR, (float)y);
+                if (out < 0) continue;
+
+                float in = internal_raster::ellipse_half_width(innerR, innerR, (float)y);
+                uint32_t* row = surface.row(cy + y);
+
+                if (in < 0) {
+                    internal_raster::sector_run(row, clip, (float)cx, (float)y, -out, out, sector, packed);
+                    continue;
+                }
+
+                // the ring is two runs on this row, just past the inner edge out to the outer one
+                float from = std::min(std::floor(in) + 1.0f, std::floor(out));
+                internal_raster::sector_run(row, clip, (float)cx, (float)y, -out, -from, sector, packed);
+                internal_raster::sector_run(row, clip, (float)cx, (float)y, from, out, sector, packed);
+            }
+        }
+
+        // Filled polygon from its edges (even-odd scanline fill), edges don't need to be in order
+        inline void polygon(SurfaceView surface, const std::vector<std::array<vec2, 2>>& edges, vec3 colour) {
+            WINHELP_PROFILE_SCOPE("draw::polygon");
+
+            if (edges.empty())
+                return;
+
+            float minY = edges[0][0].y;
+            float maxY = edges[0][0].y;
+            for (const auto& e : edges) {
+                minY = std::min({ minY, e[0].y, e[1].y });
+                maxY = std::max({ maxY, e[0].y, e[1].y });
+            }
+
+            irect clip = surface.clipRect();
+            int startY = std::max(clip.y0, (int)std::ceil(minY));
+            int endY   = std::min(clip.y1 - 1, (int)std::floor(maxY));
+
+            uint32_t packed = pack_colour(colour);
+
+            // rows are independent, a row costs a pass over the edges and its fill
+            int rowCost = (int)std::min<size_t>(edges.size() * 4 + (clip.x1 - clip.x0), 1 << 20);
+            jobs::parallel_rows(startY, endY + 1, rowCost, [&](int y0, int y1) {
+                float* hits = jobs::scratch().allocate<float>(edges.size());
+
+                for (int y = y0; y < y1; ++y) {
+                    size_t count = 0;
+
+                    for (const auto& e : edges) {
+                        vec2 a = e[0];
+                        vec2 b = e[1];
+                        if (a.y > b.y) std::swap(a, b);
+                        if (y < a.y || y >= b.y) continue;
+
+                        hits[count++] = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+                    }
+
+                    std::sort(hits, hits + count);
+
+                    for (size_t i = 0; i + 1 < count; i += 2) {
+                        int startX = std::max(clip.x0, (int)std::ceil(hits[i]));
+                        int endX   = std::min(clip.x1 - 1, (int)std::floor(hits[i + 1]));
+
+                        if (startX <= endX)
+                            internal_raster::fill_row(surface.row(y) + startX,
+                                                      endX - startX + 1, packed);
+                    }
+                }
+            });
+        }
+
+        // Many rects drawn in one call. Kept as separate arrays (structure of
+        // arrays) so the clip pass just streams through them; colours are
+        // packed once when added. Same pixels as calling draw::rect per entry.
+        struct RectBatch {
+            std::vector<float> x, y, w, h;
+            std::vector<uint32_t> colour;
+
+            void add(vec2 pos, vec2 size, uint32_t packed) {
+                x.push_back(pos.x);
+                y.push_back(pos.y);
+                w.push_back(size.x);
+                h.push_back(size.y);
+                colour.push_back(packed);
+            }
+
+            void add(vec2 pos, vec2 size, vec3 c) {
+                add(pos, size, pack_colour(c));
+            }
+
+            void reserve(size_t count) {
+                x.reserve(count); y.reserve(count);
+                w.reserve(count); h.reserve(count);
+                colour.reserve(count);
+            }
+
+            void clear() {
+                x.clear(); y.clear();
+                w.clear(); h.clear();
+                colour.clear();
+            }
+
+            size_t size() const { return x.size(); }
+        };
+
+        // Filled circles, same pixels as calling draw::circle per entry.
+        struct CircleBatch {
+            std::vector<float> x, y;
+            std::vector<int> radius;
+            std::vector<uint32_t> colour;
+
+            void add(vec2 center, int r, uint32_t packed) {
+                x.push_back(center.x);
+                y.push_back(center.y);
+                radius.push_back(r);
+                colour.push_back(packed);
+            }
+
+            void add(vec2 center, int r, vec3 c) {
+                add(center, r, pack_colour(c));
+            }
+
+            void reserve(size_t count) {
+                x.reserve(count); y.reserve(count);
+                radius.reserve(count);
+                colour.reserve(count);
+            }
+
+            void clear() {
+                x.clear(); y.clear();
+                radius.clear();
+                colour.clear();
+            }
+
+            size_t size() const { return x.size(); }
+        };
+
+        inline void rects(SurfaceView surface, const float* x, const float* y,
+                        const float* w, const float* h, const uint32_t* colours, size_t count) {
+            WINHELP_PROFILE_SCOPE("draw::rects");
+
+            int pitch = surface.pitch;
+            irect clip = surface.clipRect();
+            uint32_t* pixels = surface.pixels;
+
+            for (size_t i = 0; i < count; ++i) {
+                int px = (int)x[i];
+                int py = (int)y[i];
+
+                // clipped once here, the row loop has no checks left
+                int x0 = std::max(px, clip.x0);
+                int y0 = std::max(py, clip.y0);
+                int x1 = std::min(px + (int)w[i], clip.x1);
+                int y1 = std::min(py + (int)h[i], clip.y1);
+
+                if (x0 >= x1 || y0 >= y1)
+                    continue;
+
+                uint32_t* row = pixels + (size_t)y0 * pitch + x0;
+                for (int yy = y0; yy < y1; ++yy, row += pitch)
+                    internal_raster::fill_row(row, x1 - x0, colours[i]);
+            }
+        }
+
+        inline void rects(SurfaceView surface, const RectBatch& batch) {
+            rects(surface, batch.x.data(), batch.y.data(), batch.w.data(), batch.h.data(),
+                  batch.colour.data(), batch.size());
+        }
+
+        inline void circles(SurfaceView surface, const float* x, const float* y,
+                        const int* radius, const uint32_t* colours, size_t count) {
+            WINHELP_PROFILE_SCOPE("draw::circles");
+
+            int pitch = surface.pitch;
+            irect clip = surface.clipRect();
+            uint32_t* pixels = surface.pixels;
+
+            // batches tend to repeat radii, only look the table up when it
+            // changes (or it's too big to be kept, its rows differ per circle)
+            int lastRadius = -1;
+            internal_raster::CircleRows table = {};
+
+            for (size_t i = 0; i < count; ++i) {
+                int r = radius[i];
+                int cx = (int)x[i];
+                int cy = (int)y[i];
+
+                if (r < 0 || cx + r < clip.x0 || cx - r >= clip.x1 || cy + r < clip.y0 || cy - r >= clip.y1)
+                    continue;
+
+                int y0 = std::max(cy - r, clip.y0);
+                int y1 = std::min(cy + r + 1, clip.y1);
+
+                if (r != lastRadius || r >= internal_raster::cachedRadius) {
+                    lastRadius = r;
+                    table = internal_raster::circle_table(r, y0 - cy, y1 - 1 - cy);
+                }
+
+                uint32_t* row = pixels + (size_t)y0 * pitch;
+                for (int yy = y0; yy < y1; ++yy, row += pitch) {
+                    int span = table[std::abs(yy - cy)];
+                    int startX = std::max(cx - span, clip.x0);
+                    int endX = std::min(cx + span, clip.x1 - 1);
+                    if (startX <= endX)
+                        internal_raster::fill_row(row + startX, endX - startX + 1, colours[i]);
+                }
+            }
+        }
+
+        inline void circles(SurfaceView surface, const CircleBatch& batch) {
+            circles(surface, batch.x.data(), batch.y.data(), batch.radius.data(),
+                    batch.colour.data(), batch.size());
+        }
+    }
+
+    // Outline to coverage by signed area: every edge adds the area it covers
+    // in each pixel it crosses (and the height it spans to the pixels right
+    // of it through a running sum), so no sorting of edges or spans, and
+    // winding falls out of the sign.
+    namespace internal_outline {
+        struct Canvas {
+            int w = 0, h = 0;
+            float* a = nullptr; // w * h + 4, the last few soak up edges at x == w
+        };
+
+        inline void line(const Canvas& c, vec2 p0, vec2 p1) {
+            p0 = { std::clamp(p0.x, 0.0f, (float)c.w), std::clamp(p0.y, 0.0f, (float)c.h) };
+            p1 = { std::clamp(p1.x, 0.0f, (float)c.w), std::clamp(p1.y, 0.0f, (float)c.h) };
+
+            if (std::abs(p0.y - p1.y) <= 1e-6f)
+                return;
+
+            float dir = 1;
+            if (p0.y > p1.y) {
+                std::swap(p0, p1);
+                dir = -1;
+            }
+
+            float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+            float x = p0.x;
+            int y1 = std::min(c.h, (int)std::ceil(p1.y));
+
+            for (int y = (int)p0.y; y < y1; ++y) {
+                float* row = c.a + (size_t)y * c.w;
+                float dy = std::min((float)(y + 1), p1.y) - std::max((float)y, p0.y);
+                float xnext = x + dxdy * dy;
+                float d = dy * dir;
+
+                float x0 = std::min(x, xnext);
+                float x1 = std::max(x, xnext);
+                float x0floor = std::floor(x0);
+                float x1ceil = std::ceil(x1);
+                int x0i = (int)x0floor;
+                int x1i = (int)x1ceil;
+
+                if (x1i <= x0i + 1) {
+                    // inside one pixel, split by where the edge crosses it on average
+                    float xmf = 0.5f * (x + xnext) - x0floor;
+                    row[x0i] += d - d * xmf;
+                    row[x0i + 1] += d * xmf;
+                } else {
+                    float s = 1.0f / (x1 - x0);
+                    float x0f = x0 - x0floor;
+                    float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+                    float x1f = x1 - x1ceil + 1;
+                    float am = 0.5f * s * x1f * x1f;
+
+                    row[x0i] += d * a0;
+                    if (x1i == x0i + 2) {
+                        row[x0i + 1] += d * (1 - a0 - am);
+                    } else {
+                        float a1 = s * (1.5f - x0f);
+                        row[x0i + 1] += d * (a1 - a0);
+                        for (int xi = x0i + 2; xi < x1i - 1; ++xi)
+                            row[xi] += d * s;
+                        float a2 = a1 + (float)(x1i - x0i - 3) * s;
+                        row[x1i - 1] += d * (1 - a2 - am);
+                    }
+                    row[x1i] += d * am;
+                }
+
+                x = xnext;
+            }
+        }
+
+        // flattened into as few lines as keep within a fraction of a pixel
+        template <typename Fn>
+        void quad(vec2 p0, vec2 p1, vec2 p2, Fn&& lineTo) {
+            float devx = p0.x - 2 * p1.x + p2.x;
+            float devy = p0.y - 2 * p1.y + p2.y;
+            float devsq = devx * devx + devy * devy;
+
+            if (devsq < 0.333f) {
+                lineTo(p0, p2);
+                return;
+            }
+
+            int n = 1 + (int)std::floor(std::sqrt(std::sqrt(3.0f * devsq)));
+            vec2 previous = p0;
+
+            for (int i = 1; i <= n; ++i) {
+                float t = (float)i / n;
+                vec2 a = p0 + (p1 - p0) * t;
+                vec2 b = p1 + (p2 - p1) * t;
+                vec2 p = a + (b - a) * t;
+                lineTo(previous, p);
+                previous = p;
+            }
+        }
+
+        // running sum of the canvas, |sum| clamped to 1 is the coverage
+        inline void accumulate(const float* a, size_t count, uint8_t* out) {
+            size_t i = 0;
+            float sum = 0;
+
+#ifdef WINHELP_SSE2
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 scale = _mm_set1_ps(255.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            __m128 carry = _mm_setzero_ps();
+
+            for (; i + 4 <= count; i += 4) {
+                __m128 x = _mm_loadu_ps(a + i);
+                // prefix sum of the four, then what came before them
+                x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+                x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+                x = _mm_add_ps(x, carry);
+                carry = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+
+                __m128 y = _mm_min_ps(_mm_and_ps(x, absMask), one);
+                __m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y, scale), half));
+                v = _mm_packs_epi32(v, v);
+                v = _mm_packus_epi16(v, v);
+
+                uint32_t four = (uint32_t)_mm_cvtsi128_si32(v);
+                memcpy(out + i, &four, 4);
+            }
+
+            sum = _mm_cvtss_f32(carry);
+#endif
+
+            for (; i < count; ++i) {
+                sum += a[i];
+                out[i] = (uint8_t)(std::min(std::abs(sum), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    // A TrueType font file, or an OpenType one with TrueType outlines (CFF
+    // flavoured .otf isn't read, ok() is false for those). Reads metrics, the
+    // character map, kern pairs and outlines straight out of the file's bytes
+    // and rasterizes glyphs itself, so it works the same everywhere. Either
+    // owns the bytes (loaded from a path) or reads ones the caller keeps alive,
+    // a memory-mapped file for instance. Everything is in font units.
+    class TrueType {
+    public:
+        int unitsPerEm = 0;
+        int ascent = 0;
+        int descent = 0; // below the baseline, so usually negative
+        int lineGap = 0;
+        int glyphCount = 0;
+
+        TrueType() {}
+
+        explicit TrueType(const std::string& path) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                return;
+
+            owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            load(owned.data(), owned.size());
+        }
+
+        TrueType(const uint8_t* bytes, size_t length) {
+            load(bytes, length);
+        }
+
+        // moving keeps the owned bytes where they are
+        TrueType(TrueType&&) = default;
+        TrueType& operator=(TrueType&&) = default;
+        TrueType(const TrueType&) = delete;
+        TrueType& operator=(const TrueType&) = delete;
+
+        bool ok() const {
+            return data != nullptr;
+        }
+
+        // 0 (the missing glyph box) for a codepoint the font doesn't have
+        int glyphIndex(uint32_t codepoint) const {
+            if (cmapFormat == 4) {
+                if (codepoint > 0xFFFF)
+                    return 0;
+
+                uint32_t segments = u16(cmap + 6) / 2;
+                uint32_t ends = cmap + 14;
+                uint32_t starts = ends + segments * 2 + 2;
+                uint32_t deltas = starts + segments * 2;
+                uint32_t offsets = deltas + segments * 2;
+
+                // first segment ending at or after codepoint
+                uint32_t lo = 0, hi = segments;
+                while (lo < hi) {
+                    uint32_t mid = (lo + hi) / 2;
+                    if (u16(ends + mid * 2) < codepoint)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+
+                if (lo == segments || codepoint < u16(starts + lo * 2))
+                    return 0;
+
+                uint32_t delta = u16(deltas + lo * 2);
+                uint32_t offset = u16(offsets + lo * 2);
+                if (offset == 0)
+                    return (codepoint + delta) & 0xFFFF;
+
+                uint32_t glyph = u16(offsets + lo * 2 + offset + (codepoint - u16(starts + lo * 2)) * 2);
+                return glyph ? (glyph + delta) & 0xFFFF : 0;
+            }
+
+            if (cmapFormat == 12) {
+                uint32_t groups = u32(cmap + 12);
+                uint32_t lo = 0, hi = groups;
+                while (lo < hi) {
+                    uint32_t mid = (lo + hi) / 2;
+                    uint32_t group = cmap + 16 + mid * 12;
+                    if (codepoint < u32(group))
+                        hi = mid;
+                    else if (codepoint > u32(group + 4))
+                        lo = mid + 1;
+                    else
+                        return (int)(u32(group + 8) + codepoint - u32(group));
+                }
+            }
+
+            return 0;
+        }
+
+        // every codepoint the font maps, fn(codepoint, glyph)
+        template <typename Fn>
+        void forEachCodepoint(Fn fn) const {
+            if (cmapFormat == 4) {
+                uint32_t segments = u16(cmap + 6) / 2;
+                for (uint32_t s = 0; s < segments; ++s) {
+                    uint32_t end = u16(cmap + 14 + s * 2);
+                    uint32_t start = u16(cmap + 16 + segments * 2 + s * 2);
+                    for (uint32_t cp = start; cp <= end && cp < 0xFFFF; ++cp)
+                        if (int g = glyphIndex(cp))
+                            fn(cp, g);
+                }
+            } else if (cmapFormat == 12) {
+                uint32_t groups = u32(cmap + 12);
+                for (uint32_t i = 0; i < groups; ++i) {
+                    uint32_t group = cmap + 16 + i * 12;
+                    uint32_t start = u32(group);
+                    uint32_t end = std::min(u32(group + 4), 0x10FFFFu);
+                    for (uint32_t cp = start; cp <= end && cp >= start; ++cp)
+                        fn(cp, (int)(u32(group + 8) + cp - start));
+                }
+            }
+        }
+
+        int advance(int glyph) const {
+            if (metricCount == 0)
+                return 0;
+            return u16(hmtx + 4 * (uint32_t)std::clamp(glyph, 0, metricCount - 1));
+        }
+
+        // the kern table's adjustment between two glyphs
+        int kerning(int left, int right) const {
+            uint32_t key = (uint32_t)left << 16 | (uint32_t)right;
+            uint32_t lo = 0, hi = kernPairs;
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                uint32_t pair = kern + mid * 6;
+                uint32_t at = u32(pair);
+                if (at == key)
+                    return s16(pair + 4);
+                if (at < key)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return 0;
+        }
+
+        // every kern pair, fn(left glyph, right glyph, amount)
+        template <typename Fn>
+        void forEachKerningPair(Fn fn) const {
+            for (uint32_t i = 0; i < kernPairs; ++i)
+                fn((int)u16(kern + i * 6), (int)u16(kern + i * 6 + 2), (int)s16(kern + i * 6 + 4));
+        }
+
+        // the glyph scaled by pixels per font unit into coverage. offset is
+        // where its top left is relative to the pen on the baseline, y down.
+        // False for a glyph with no outline (a space), which draws nothing.
+        bool rasterize(int glyph, float scale, MaskSurface& out, ivec2& offset) const {
+            thread_local std::vector<vec2> lines;
+            thread_local std::vector<float> canvas;
+
+            ivec2 size;
+            if (!flatten(glyph, scale, 0, lines, size, offset))
+                return false;
+
+            internal_outline::Canvas c;
+            c.w = size.x;
+            c.h = size.y;
+            canvas.assign((size_t)c.w * c.h + 4, 0.0f);
+            c.a = canvas.data();
+
+            for (size_t i = 0; i < lines.size(); i += 2)
+                internal_outline::line(c, lines[i], lines[i + 1]);
+
+            out = MaskSurface({ (float)c.w, (float)c.h });
+            internal_outline::accumulate(c.a, (size_t)c.w * c.h, out.pixels.data());
+            return true;
+        }
+
+        // the glyph as a signed distance field: 128 on the outline, up to 255
+        // `spread` pixels inside it and down to 0 as far outside, with that
+        // much room around it. Sampled at any size it gives smooth edges.
+        bool distanceField(int glyph, float scale, int spread, MaskSurface& out, ivec2& offset) const {
+            thread_local std::vector<vec2> lines;
+            thread_local std::vector<float> canvas;
+            thread_local std::vector<float> nearest;
+
+            ivec2 size;
+            if (!flatten(glyph, scale, spread, lines, size, offset))
+                return false;
+
+            // inside or out from the coverage, which already knows the winding
+            internal_outline::Canvas c;
+            c.w = size.x;
+            c.h = size.y;
+            canvas.assign((size_t)c.w * c.h + 4, 0.0f);
+            c.a = canvas.data();
+            for (size_t i = 0; i < lines.size(); i += 2)
+                internal_outline::line(c, lines[i], lines[i + 1]);
+
+            out = MaskSurface({ (float)c.w, (float)c.h });
+            internal_outline::accumulate(c.a, (size_t)c.w * c.h, out.pixels.data());
+
+            // squared distance from every pixel centre to the closest line,
+            // a line at a time so the inner loop is a plain row sweep
+            float reach = (float)spread * spread;
+            nearest.assign((size_t)c.w * c.h, reach);
+
+            for (size_t i = 0; i < lines.size(); i += 2) {
+                vec2 a = lines[i], b = lines[i + 1];
+                vec2 ab = b - a;
+                float length = ab.x * ab.x + ab.y * ab.y;
+                float inverse = length > 0 ? 1.0f / length : 0.0f;
+
+                int y0 = std::max(0, (int)std::floor(std::min(a.y, b.y) - spread));
+                int y1 = std::min(c.h, (int)std::ceil(std::max(a.y, b.y) + spread));
+                int x0 = std::max(0, (int)std::floor(std::min(a.x, b.x) - spread));
+                int x1 = std::min(c.w, (int)std::ceil(std::max(a.x, b.x) + spread));
+
+                for (int y = y0; y < y1; ++y) {
+                    float* row = nearest.data() + (size_t)y * c.w;
+                    float py = y + 0.5f - a.y;
+
+                    for (int x = x0; x < x1; ++x) {
+                        float px = x + 0.5f - a.x;
+                        float t = std::clamp((px * ab.x + py * ab.y) * inverse, 0.0f, 1.0f);
+                        float dx = px - ab.x * t;
+                        float dy = py - ab.y * t;
+                        row[x] = std::min(row[x], dx * dx + dy * dy);
+                    }
+                }
+            }
+
+            float toByte = 127.0f / spread;
+            for (size_t i = 0; i < nearest.size(); ++i) {
+                float distance = std::sqrt(nearest[i]);
+                if (out.pixels[i] < 128)
+                    distance = -distance;
+                out.pixels[i] = (uint8_t)std::clamp(128.0f + distance * toByte + 0.5f, 0.0f, 255.0f);
+            }
+
+            return true;
+        }
+
+    private:
+        struct Point {
+            float x, y;
+            bool on; // on the curve, or a quadratic's control point
+        };
+
+        std::vector<uint8_t> owned;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        uint32_t loca = 0, glyf = 0, hmtx = 0;
+        uint32_t cmap = 0;     // the chosen subtable
+        uint32_t kern = 0;     // first pair of the horizontal format 0 subtable
+        uint32_t kernPairs = 0;
+        int cmapFormat = 0;
+        int metricCount = 0;
+        bool longOffsets = false;
+        int xMin = 0, yMin = 0, xMax = 0, yMax = 0; // every glyph's box, from head
+
+        // big-endian, 0 past the end so a broken file reads as empty rather than crashing
+        uint32_t u8(size_t at) const {
+            return at < size ? data[at] : 0;
+        }
+
+        uint32_t u16(size_t at) const {
+            return u8(at) << 8 | u8(at + 1);
+        }
+
+        int s16(size_t at) const {
+            return (int16_t)u16(at);
+        }
+
+        uint32_t u32(size_t at) const {
+            return u16(at) << 16 | u16(at + 2);
+        }
+
+        uint32_t table(uint32_t directory, const char* tag) const {
+            uint32_t tables = u16(directory + 4);
+            for (uint32_t i = 0; i < tables; ++i) {
+                uint32_t record = directory + 12 + i * 16;
+                if (record + 16 <= size && memcmp(data + record, tag, 4) == 0)
+                    return u32(record + 8) < size ? u32(record + 8) : 0;
+            }
+            return 0;
+        }
+
+        void load(const uint8_t* bytes, size_t length) {
+            data = bytes;
+            size = length;
+
+            // a collection (.ttc) reads as its first font
+            uint32_t directory = 0;
+            if (u32(0) == 0x74746366) // 'ttcf'
+                directory = u32(12);
+
+            uint32_t version = u32(directory);
+            if (version != 0x00010000 && version != 0x74727565) { // 'true', 'OTTO' is CFF
+                data = nullptr;
+                return;
+            }
+
+            uint32_t head = table(directory, "head");
+            uint32_t hhea = table(directory, "hhea");
+            uint32_t maxp = table(directory, "maxp");
+            uint32_t charMap = table(directory, "cmap");
+            loca = table(directory, "loca");
+            glyf = table(directory, "glyf");
+            hmtx = table(directory, "hmtx");
+
+            if (!head || !hhea || !maxp || !charMap || !loca || !glyf || !hmtx) {
+                data = nullptr;
+                return;
+            }
+
+            unitsPerEm = (int)u16(head + 18);
+            longOffsets = s16(head + 50) != 0;
+            xMin = s16(head + 36);
+            yMin = s16(head + 38);
+            xMax = s16(head + 40);
+            yMax = s16(head + 42);
+            ascent = s16(hhea + 4);
+            descent = s16(hhea + 6);
+            lineGap = s16(hhea + 8);
+            metricCount = (int)u16(hhea + 34);
+            glyphCount = (int)u16(maxp + 4);
+
+            // Windows full Unicode, then Unicode platform, then Windows BMP
+            int best = 0;
+            uint32_t records = u16(charMap + 2);
+            for (uint32_t i = 0; i < records; ++i) {
+                uint32_t record = charMap + 4 + i * 8;
+                uint32_t platform = u16(record), encoding = u16(record + 2);
+                uint32_t subtable = charMap + u32(record + 4);
+                int format = (int)u16(subtable);
+
+                int score = 0;
+                if (format == 12 && (platform == 0 || (platform == 3 && encoding == 10)))
+                    score = 3;
+                else if (format == 4 && platform == 0)
+                    score = 2;
+                else if (format == 4 && platform == 3 && encoding == 1)
+                    score = 1;
+
+                if (score > best) {
+                    best = score;
+                    cmap = subtable;
+                    cmapFormat = format;
+                }
+            }
+
+            if (!unitsPerEm || !cmapFormat) {
+                data = nullptr;
+                return;
+            }
+
+            // only the first subtable, if it is horizontal format 0 pairs
+            if (uint32_t k = table(directory, "kern")) {
+                uint32_t coverage = u16(k + 8);
+                if (u16(k) == 0 && u16(k + 2) > 0 && (coverage >> 8) == 0 && (coverage & 1)) {
+                    kern = k + 18;
+                    kernPairs = u16(k + 10);
+                }
+            }
+        }
+
+        // the glyph as line segments (pairs of points) in pixels with `pad`
+        // pixels clear on every side, y down, and the box that holds them
+        bool flatten(int glyph, float scale, int pad, std::vector<vec2>& lines, ivec2& size, ivec2& offset) const {
+            thread_local std::vector<Point> points;
+            thread_local std::vector<int> ends;
+
+            points.clear();
+            ends.clear();
+            lines.clear();
+            outline(glyph, { 1, 0, 0, 1, 0, 0 }, points, ends, 0);
+            if (points.empty())
+                return false;
+
+            float minX = points[0].x, maxX = minX, minY = points[0].y, maxY = minY;
+            for (const Point& p : points) {
+                minX = std::min(minX, p.x);
+                maxX = std::max(maxX, p.x);
+                minY = std::min(minY, p.y);
+                maxY = std::max(maxY, p.y);
+            }
+
+            // a broken glyph (or composite) can land anywhere, nothing is
+            // allocated for one outside the font's box (an em of slack, head
+            // isn't always exact) or more than 16 ems across
+            float em = (float)unitsPerEm;
+            if (minX < xMin - em || maxX > xMax + em || minY < yMin - em || maxY > yMax + em ||
+                maxX - minX > 16 * em || maxY - minY > 16 * em)
+                return false;
+
+            int x0 = (int)std::floor(minX * scale) - pad;
+            int x1 = (int)std::ceil(maxX * scale) + pad;
+            int top = (int)std::ceil(maxY * scale) + pad;
+            int bottom = (int)std::floor(minY * scale) - pad;
+            if (x1 - x0 <= 2 * pad || top - bottom <= 2 * pad)
+                return false;
+
+            size = { x1 - x0, top - bottom };
+            offset = { x0, -top };
+
+            auto at = [&](const Point& p) {
+                return vec2(p.x * scale - x0, top - p.y * scale);
+            };
+            auto lineTo = [&](vec2 a, vec2 b) {
+                lines.push_back(a);
+                lines.push_back(b);
+            };
+
+            size_t first = 0;
+            for (int end : ends) {
+                size_t count = (size_t)end + 1 - first;
+                if (count < 2) {
+                    first = (size_t)end + 1;
+                    continue;
+                }
+
+                auto point = [&](size_t i) -> const Point& {
+                    return points[first + i % count];
+                };
+
+                // start on the curve, between the first and last points if neither is
+                size_t from = 0;
+                while (from < count && !point(from).on)
+                    ++from;
+
+                vec2 start;
+                size_t steps;
+                if (from < count) {
+                    start = at(point(from));
+                    from += 1;
+                    steps = count - 1;
+                } else {
+                    start = (at(point(count - 1)) + at(point(0))) * 0.5f;
+                    from = 0;
+                    steps = count;
+                }
+
+                vec2 pen = start;
+                vec2 control;
+                bool curving = false;
+
+                for (size_t i = 0; i < steps; ++i) {
+                    const Point& p = point(from + i);
+                    vec2 v = at(p);
+
+                    if (p.on) {
+                        if (curving)
+                            internal_outline::quad(pen, control, v, lineTo);
+                        else
+                            lineTo(pen, v);
+                        pen = v;
+                        curving = false;
+                    } else {
+                        // two controls in a row have an implied point halfway
+                        if (curving) {
+                            vec2 middle = (control + v) * 0.5f;
+                            internal_outline::quad(pen, control, middle, lineTo);
+                            pen = middle;
+                        }
+                        control = v;
+                        curving = true;
+                    }
+                }
+
+                if (curving)
+                    internal_outline::quad(pen, control, start, lineTo);
+                else
+                    lineTo(pen, start);
+
+                first = (size_t)end + 1;
+            }
+
+            return true;
+        }
+
+        // glyph's outline points, through a 2x2 and offset for components of composite glyphs
+        void outline(int glyph, const std::array<float, 6>& m, std::vector<Point>& points,
+            std::vector<int>& ends, int depth) const {
+
+            if (glyph < 0 || glyph >= glyphCount || depth > 8)
+                return;
+
+            uint32_t start, end;
+            if (longOffsets) {
+                start = u32(loca + glyph * 4);
+                end = u32(loca + glyph * 4 + 4);
+            } else {
+                start = u16(loca + glyph * 2) * 2;
+                end = u16(loca + glyph * 2 + 2) * 2;
+            }
+            if (end <= start || glyf + (size_t)end > size)
+                return;
+
+            uint32_t at = glyf + start;
+            int contours = s16(at);
+
+            if (contours >= 0) {
+                uint32_t endPoints = at + 10;
+                size_t count = contours ? u16(endPoints + (contours - 1) * 2) + 1 : 0;
+                uint32_t p = endPoints + contours * 2;
+                p += 2 + u16(p); // instructions
+
+                thread_local std::vector<uint8_t> flags;
+                flags.clear();
+                while (flags.size() < count && p < size) {
+                    uint8_t flag = (uint8_t)u8(p++);
+                    flags.push_back(flag);
+                    if (flag & 8)
+                        for (uint32_t repeat = u8(p++); repeat && flags.size() < count; --repeat)
+                            flags.push_back(flag);
+                }
+                if (flags.size() < count)
+                    return;
+
+                size_t base = points.size();
+                points.resize(base + count);
+
+                // x then y, each a byte with the sign in the flags, the same as before, or a short
+                int value = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    uint8_t flag = flags[i];
+                    if (flag & 2)
+                        value += (flag & 16) ? (int)u8(p++) : -(int)u8(p++);
+                    else if (!(flag & 16)) {
+                        value += s16(p);
+                        p += 2;
+                    }
+                    points[base + i].x = (float)value;
+                    points[base + i].on = flag & 1;
+                }
+
+                value = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    uint8_t flag = flags[i];
+                    if (flag & 4)
+                        value += (flag & 32) ? (int)u8(p++) : -(int)u8(p++);
+                    else if (!(flag & 32)) {
+                        value += s16(p);
+                        p += 2;
+                    }
+                    points[base + i].y = (float)value;
+                }
+
+                for (size_t i = base; i < points.size(); ++i) {
+                    float x = points[i].x, y = points[i].y;
+                    points[i].x = m[0] * x + m[2] * y + m[4];
+                    points[i].y = m[1] * x + m[3] * y + m[5];
+                }
+
+                for (int i = 0; i < contours; ++i) {
+                    int last = (int)u16(endPoints + i * 2);
+                    if (last >= (int)count)
+                        last = (int)count - 1;
+                    ends.push_back((int)base + last);
+                }
+                return;
+            }
+
+            // composite, other glyphs moved, scaled or both
+            at += 10;
+            uint32_t flags;
+            do {
+                flags = u16(at);
+                int component = (int)u16(at + 2);
+                at += 4;
+
+                float dx, dy;
+                if (flags & 1) {
+                    dx = (float)s16(at);
+                    dy = (float)s16(at + 2);
+                    at += 4;
+                } else {
+                    dx = (float)(int8_t)u8(at);
+                    dy = (float)(int8_t)u8(at + 1);
+                    at += 2;
+                }
+
+                // 2.14 fixed point
+                auto f2dot14 = [&](uint32_t offset) { return s16(offset) / 16384.0f; };
+                float a = 1, b = 0, c = 0, d = 1;
+                if (flags & 8) {
+                    a = d = f2dot14(at);
+                    at += 2;
+                } else if (flags & 0x40) {
+                    a = f2dot14(at);
+                    d = f2dot14(at + 2);
+                    at += 4;
+                } else if (flags & 0x80) {
+                    a = f2dot14(at);
+                    b = f2dot14(at + 2);
+                    c = f2dot14(at + 4);
+                    d = f2dot14(at + 6);
+                    at += 8;
+                }
+
+                // matching points instead of an offset isn't supported, those land unmoved
+                if (!(flags & 2))
+                    dx = dy = 0;
+
+                std::array<float, 6> combined = {
+                    m[0] * a + m[2] * b, m[1] * a + m[3] * b,
+                    m[0] * c + m[2] * d, m[1] * c + m[3] * d,
+                    m[0] * dx + m[2] * dy + m[4], m[1] * dx + m[3] * dy + m[5],
+                };
+                outline(component, combined, points, ends, depth + 1);
+            } while ((flags & 0x20) && at < size);
+        }
+    };
+
+    // Every glyph a font has drawn so far, rasterized once into one A8 sheet
+    // (shelves, grows downwards as needed) with its metrics, plus the font's
+    // kerning pairs. Text is measured from the advances and drawn straight out
+    // of the sheet into the target, nothing in between. A glyph not in the
+    // atlas yet goes to `rasterize`, which its owner (Font) sets up.
+    struct GlyphAtlas {
+        struct Glyph {
+            ivec2 pos;    // top left in the sheet
+            ivec2 size;
+            ivec2 offset; // top left relative to the pen, which is at the top of the line
+            int advance = 0;
+        };
+
+        // a glyph as a rasterizer hands it over
+        struct Bitmap {
+            MaskSurface coverage;
+            ivec2 offset;
+            int advance = 0;
+        };
+
+        // false for a glyph the font doesn't have, which then takes no space
+        std::function<bool(uint32_t codepoint, Bitmap& out)> rasterize;
+
+        int lineHeight = 0;
+        MaskSurface sheet;
+
+        explicit GlyphAtlas(int sheetWidth = 512) : sheet({ (float)sheetWidth, 0 }), pages(0x1100, -1) {
+            latin.fill(-1);
+        }
+
+        // cached, or rasterized and cached now. The reference only lasts
+        // until the next glyph is loaded.
+        const Glyph& glyph(uint32_t codepoint) {
+            if (codepoint > 0x10FFFF)
+                codepoint = utf8::replacement;
+
+            const Glyph* g = find(codepoint);
+            return g ? *g : load(codepoint);
+        }
+
+        // cached only, nullptr if it was never loaded. Changes nothing, so
+        // any number of threads can look up at once while none loads.
+        const Glyph* find(uint32_t codepoint) const {
+            if (codepoint < 256)
+                return latin[codepoint] >= 0 ? &glyphs[latin[codepoint]] : nullptr;
+
+            if (codepoint > 0x10FFFF)
+                codepoint = utf8::replacement;
+
+            int16_t page = pages[codepoint >> 8];
+            if (page < 0)
+                return nullptr;
+            int i = slots[page][codepoint & 0xFF];
+            return i >= 0 ? &glyphs[i] : nullptr;
+        }
+
+        void setKerning(uint32_t left, uint32_t right, int amount) {
+            kerningPairs[(uint64_t)left << 32 | right] = amount;
+        }
+
+        int kerning(uint32_t left, uint32_t right) const {
+            if (kerningPairs.empty())
+                return 0;
+
+            auto it = kerningPairs.find((uint64_t)left << 32 | right);
+            return it == kerningPairs.end() ? 0 : it->second;
+        }
+
+        // how far the pen moves over text, and the line height
+        ivec2 measure(std::string_view text) {
+            int width = 0;
+            uint32_t previous = 0;
+
+            utf8::for_each(text, [&](uint32_t c, size_t) {
+                width += kerning(previous, c) + glyph(c).advance;
+                previous = c;
+            });
+
+            return { width, lineHeight };
+        }
+
+        // text with the top left of its line at position, colour.w scaling the coverage
+        void draw(SurfaceView target, vec2 position, std::string_view text, vec4 colour,
+            blend_mode mode = blend_mode::alpha) {
+            drawWith(target, position, text, colour, mode, [&](uint32_t c) { return &glyph(c); });
+        }
+
+        // the same from the glyphs already loaded only, any other is left
+        // out. Loads nothing, so it can run on several threads at once.
+        void drawLoaded(SurfaceView target, vec2 position, std::string_view text, vec4 colour,
+            blend_mode mode = blend_mode::alpha) const {
+            drawWith(target, position, text, colour, mode, [&](uint32_t c) { return find(c); });
+        }
+
+        // text's coverage into mask with the line's top left at `at`. Where
+        // glyphs overlap the higher coverage wins.
+        void coverage(MaskSurface& mask, ivec2 at, std::string_view text) {
+            int x = at.x;
+            uint32_t previous = 0;
+
+            utf8::for_each(text, [&](uint32_t c, size_t) {
+                x += kerning(previous, c);
+                previous = c;
+
+                const Glyph& g = glyph(c);
+                irect area = irect(x + g.offset.x, at.y + g.offset.y, x + g.offset.x + g.size.x, at.y + g.offset.y + g.size.y)
+                    .intersect(irect(0, 0, mask.size.x, mask.size.y));
+
+                for (int y = area.y0; y < area.y1; ++y) {
+                    const uint8_t* src = sheet.row(g.pos.y + y - (at.y + g.offset.y)) + g.pos.x - (x + g.offset.x);
+                    uint8_t* dst = mask.row(y);
+                    for (int px = area.x0; px < area.x1; ++px)
+                        dst[px] = std::max(dst[px], src[px]);
+                }
+
+                x += g.advance;
+            });
+        }
+
+        // where text breaks into lines, appended to lines as [begin, end):
+        // at every '\n', and with a width > 0 before the word that would run
+        // past it. A word wider than the whole width is cut where it has to be.
+        void wrap(std::string_view text, int width, std::vector<std::pair<size_t, size_t>>& lines) {
+            size_t begin = 0;
+
+            while (true) {
+                size_t end = std::min(text.find('\n', begin), text.size());
+
+                if (width > 0) {
+                    size_t start = begin;
+                    size_t space = std::string_view::npos; // last place the line could break
+                    int x = 0;
+                    uint32_t previous = 0;
+
+                    for (size_t i = begin; i < end;) {
+                        size_t at = i;
+                        uint32_t c = utf8::next(text, i); // '\n' can't be inside a sequence, i stays <= end
+                        int step = kerning(previous, c) + glyph(c).advance;
+                        previous = c;
+
+                        if (c == ' ') {
+                            space = at;
+                        } else if (x + step > width && at > start) {
+                            if (space != std::string_view::npos && space > start) {
+                                lines.push_back({ start, space });
+                                start = space + 1;
+                            } else {
+                                lines.push_back({ start, at });
+                                start = at;
+                            }
+                            space = std::string_view::npos;
+                            x = measure(text.substr(start, i - start)).x;
+                            continue;
+                        }
+
+                        x += step;
+                    }
+
+                    lines.push_back({ start, end });
+                } else {
+                    lines.push_back({ begin, end });
+                }
+
+                if (end == text.size())
+                    return;
+                begin = end + 1;
+            }
+        }
+
+        size_t glyphCount() const {
+            return glyphs.size();
+        }
+
+        void clearKerning() {
+            kerningPairs.clear();
+        }
+
+        // forget every glyph (the font changed), kerning stays
+        void clear() {
+            glyphs.clear();
+            latin.fill(-1);
+            std::fill(pages.begin(), pages.end(), (int16_t)-1);
+            slots.clear();
+            shelf = { 0, 0 };
+            shelfHeight = 0;
+            sheet.size.y = 0;
+            sheet.pixels.clear();
+        }
+
+    private:
+        // lookup(codepoint) hands over each glyph, nullptr skips it
+        template <typename Lookup>
+        void drawWith(SurfaceView target, vec2 position, std::string_view text, vec4 colour,
+            blend_mode mode, Lookup&& lookup) const;
+
+        std::vector<Glyph> glyphs;
+        // glyphs index of every codepoint loaded, or -1. Latin-1 straight in
+        // here, past it a page of 256 slots per codepoint >> 8, made when the
+        // first codepoint in it loads
+        std::array<int, 256> latin;
+        std::vector<int16_t> pages;
+        std::vector<std::array<int, 256>> slots;
+        std::unordered_map<uint64_t, int> kerningPairs;
+
+        ivec2 shelf;         // where the next glyph goes
+        int shelfHeight = 0; // tallest glyph on the current shelf
+
+        const Glyph& load(uint32_t codepoint) {
+            Bitmap bitmap;
+            Glyph g;
+
+            if (rasterize && rasterize(codepoint, bitmap)) {
+                g.size = bitmap.coverage.size;
+                g.offset = bitmap.offset;
+                g.advance = bitmap.advance;
+                g.pos = place(g.size);
+
+                for (int y = 0; y < g.size.y; ++y)
+                    memcpy(sheet.row(g.pos.y + y) + g.pos.x, bitmap.coverage.row(y), g.size.x);
+            }
+
+            int i = (int)glyphs.size();
+            glyphs.push_back(g);
+
+            if (codepoint < 256) {
+                latin[codepoint] = i;
+            } else {
+                int16_t& page = pages[codepoint >> 8];
+                if (page < 0) {
+                    page = (int16_t)slots.size();
+                    slots.emplace_back();
+                    slots.back().fill(-1);
+                }
+                slots[page][codepoint & 0xFF] = i;
+            }
+
+            return glyphs.back();
+        }
+
+        // room for size on the sheet, a pixel apart from its neighbours
+        ivec2 place(ivec2 size) {
+            if (size.x <= 0 || size.y <= 0)
+                return { 0, 0 };
+
+            if (size.x > sheet.pitch)
+                resize(size.x, sheet.size.y);
+
+            if (shelf.x + size.x > sheet.pitch) {
+                shelf = { 0, shelf.y + shelfHeight + 1 };
+                shelfHeight = 0;
+            }
+
+            if (shelf.y + size.y > sheet.size.y)
+                resize(sheet.pitch, std::max({ 64, sheet.size.y * 2, shelf.y + size.y }));
+
+            ivec2 at = shelf;
+            shelf.x += size.x + 1;
+            shelfHeight = std::max(shelfHeight, size.y);
+            return at;
+        }
+
+        // new rows go on the end so glyphs keep their place, only a wider
+        // sheet has to move them
+        void resize(int width, int height) {
+            if (width == sheet.pitch) {
+                sheet.pixels.resize((size_t)width * height, 0);
+                sheet.size.y = height;
+                return;
+            }
+
+            MaskSurface wider({ (float)width, (float)height });
+            for (int y = 0; y < sheet.size.y; ++y)
+                memcpy(wider.row(y), sheet.row(y), sheet.size.x);
+            sheet = std::move(wider);
+        }
+    };
+
+    template <typename Lookup>
+    inline void GlyphAtlas::drawWith(SurfaceView target, vec2 position, std::string_view text, vec4 colour,
+        blend_mode mode, Lookup&& lookup) const {
+
+        WINHELP_PROFILE_SCOPE("GlyphAtlas::draw");
+
+        uint32_t alpha = (uint32_t)std::clamp(colour.w, 0.0f, 255.0f);
+        irect clip = target.clipRect();
+        int x = (int)position.x;
+        int y = (int)position.y;
+
+        // a whole line above or below the clip draws nothing
+        if (alpha == 0 || clip.empty() || y >= clip.y1 || y + lineHeight <= clip.y0)
+            return;
+
+        uint32_t packed = draw::pack_colour(vec3(colour));
+        internal_blend::mask_fn maskRow = internal_blend::pick_mask(mode);
+        uint32_t previous = 0;
+
+        utf8::for_each(text, [&](uint32_t c, size_t) {
+            x += kerning(previous, c);
+            previous = c;
+
+            const Glyph* g = lookup(c);
+            if (!g)
+                return;
+            if (g->size.x > 0)
+                draw::internal_mask::blit(target, sheet.row(g->pos.y) + g->pos.x, sheet.pitch, g->size,
+                    { x + g->offset.x, y + g->offset.y }, packed, alpha, maskRow);
+
+            x += g->advance;
+        });
+    }
+
+    // A font at one pixel size: a TrueType/OpenType file read by TrueType on
+    // any platform, or on Windows a GDI font by name. Glyphs are rasterized
+    // once each into a GlyphAtlas, after that measuring and drawing text never
+    // goes back to the font.
+    class Font {
+    private:
+#ifdef _WIN32
+        HFONT hfont = nullptr;
+        HDC   hdc = nullptr;
+#endif
+        TrueType face; // not ok() for a GDI font
+        int   size;
+        int   ascent = 0;
+        std::wstring name;
+        mutable GlyphAtlas atlas; // sizeOf is const but may still load glyphs
+
+        // distance fields for drawScaled, made at one size for every size
+        static constexpr int fieldSize = 48;  // pixels per em
+        static constexpr int fieldSpread = 6; // pixels of distance either side of the edge
+        mutable GlyphAtlas fields;
+
+        uint32_t generation = 0; // bumped whenever the glyphs change
+        std::vector<const Font*> fallbacks;
+
+    public:
+        int lineHeight;
+
+#ifdef _WIN32
+        Font(int fontSize = 16, const std::wstring& fontName = L"Consolas") 
+        : hfont(nullptr),
+        hdc(nullptr),
+        size(fontSize),
+        name(fontName),
+        lineHeight([&]() { // yes i hate you, what you gona do about it?
+            SetMapMode(hdc, MM_TEXT);
+            SetGraphicsMode(hdc, GM_COMPATIBLE);
+
+            HFONT tempFont = CreateFontW(
+                -fontSize,
+                0, 0, 0,
+                FW_NORMAL,
+                FALSE, FALSE, FALSE,
+                DEFAULT_CHARSET,
+                OUT_DEFAULT_PRECIS,
+                CLIP_DEFAULT_PRECIS,
+                ANTIALIASED_QUALITY,
+                DEFAULT_PITCH | FF_DONTCARE,
+                fontName.c_str()
+            );
+
+            SelectObject(hdc, tempFont);
+
+            TEXTMETRIC tm{};
+            int h = fontSize;
+            if (GetTextMetrics(hdc, &tm))
+                h = tm.tmHeight;
+
+            DeleteObject(tempFont);
+            return h;
+        }()) {
+            hdc = CreateCompatibleDC(nullptr);
+
+            SetMapMode(hdc, MM_TEXT);
+            SetGraphicsMode(hdc, GM_COMPATIBLE);
+
+            hfont = CreateFontW(
+                -size,
+                0, 0, 0,
+                FW_NORMAL,
+                FALSE, FALSE, FALSE,
+                DEFAULT_CHARSET,
+                OUT_DEFAULT_PRECIS,
+                CLIP_DEFAULT_PRECIS,
+                ANTIALIASED_QUALITY,
+                DEFAULT_PITCH | FF_DONTCARE,
+                name.c_str()
+            );
+
+            SelectObject(hdc, hfont);
+
+            TEXTMETRIC tm{};
+            atlas.lineHeight = lineHeight;
+            if (GetTextMetrics(hdc, &tm)) {
+                ascent = tm.tmAscent;
+                atlas.lineHeight = tm.tmHeight;
+            }
+
+            DWORD pairs = GetKerningPairsW(hdc, 0, nullptr);
+            if (pairs) {
+                std::vector<KERNINGPAIR> kerning(pairs);
+                pairs = GetKerningPairsW(hdc, pairs, kerning.data());
+                for (DWORD i = 0; i < pairs; ++i)
+                    atlas.setKerning(kerning[i].wFirst, kerning[i].wSecond, kerning[i].iKernAmount);
+            }
+
+            atlas.rasterize = [this](uint32_t codepoint, GlyphAtlas::Bitmap& out) {
+                return rasterizeAny(codepoint, out);
+            };
+        }
+#endif
+
+        // a .ttf/.otf file, size in pixels per em
+        Font(const std::string& path, int fontSize)
+        : face(path),
+        size(fontSize),
+        lineHeight(faceHeight(face, fontSize)) {
+            useFace();
+        }
+
+        // the same out of memory the caller keeps alive for as long as the font
+        Font(const uint8_t* bytes, size_t length, int fontSize)
+        : face(bytes, length),
+        size(fontSize),
+        lineHeight(faceHeight(face, fontSize)) {
+            useFace();
+        }
+
+        // the atlas points back at this font
+        Font(const Font&) = delete;
+        Font& operator=(const Font&) = delete;
+
+        ~Font() {
+#ifdef _WIN32
+            if (hfont) {
+                DeleteObject(hfont);
+                hfont = nullptr;
+            }
+            if (hdc) {
+                DeleteDC(hdc);
+                hdc = nullptr;
+            }
+#endif
+        }
+
+        // false if the file couldn't be read (or isn't a font TrueType reads)
+        bool ok() const {
+#ifdef _WIN32
+            if (hfont)
+                return true;
+#endif
+            return face.ok();
+        }
+
+        // where glyphs this font doesn't have come from (symbols, CJK,
+        // emoji), tried in the order added and drawn on this font's baseline.
+        // The fallback has to outlive this font.
+        void addFallback(const Font& fallback) {
+            if (&fallback == this)
+                return;
+
+            fallbacks.push_back(&fallback);
+            atlas.clear(); // glyphs missing so far may not be any more
+            generation++;
+        }
+
+    private:
+        static int faceHeight(const TrueType& face, int fontSize) {
+            if (!face.ok())
+                return fontSize;
+
+            float scale = (float)fontSize / face.unitsPerEm;
+            return (int)std::ceil(face.ascent * scale) + (int)std::ceil(-face.descent * scale);
+        }
+
+        void useFace() {
+            atlas.lineHeight = lineHeight;
+            if (!face.ok())
+                return;
+
+            float scale = (float)size / face.unitsPerEm;
+            ascent = (int)std::ceil(face.ascent * scale);
+
+            // kern pairs are between glyphs, the atlas keys them by codepoint
+            std::unordered_map<int, std::vector<uint32_t>> codepoints;
+            face.forEachKerningPair([&](int left, int right, int) {
+                codepoints[left];
+                codepoints[right];
+            });
+
+            if (!codepoints.empty()) {
+                face.forEachCodepoint([&](uint32_t codepoint, int glyph) {
+                    auto it = codepoints.find(glyph);
+                    if (it != codepoints.end())
+                        it->second.push_back(codepoint);
+                });
+
+                face.forEachKerningPair([&](int left, int right, int amount) {
+                    int pixels = (int)std::lround(amount * scale);
+                    if (pixels == 0)
+                        return;
+                    for (uint32_t l : codepoints[left])
+                        for (uint32_t r : codepoints[right])
+                            atlas.setKerning(l, r, pixels);
+                });
+            }
+
+            fields.rasterize = [this](uint32_t codepoint, GlyphAtlas::Bitmap& out) {
+                int glyph = face.glyphIndex(codepoint);
+                if (glyph == 0)
+                    return false;
+
+                face.distanceField(glyph, (float)fieldSize / face.unitsPerEm, fieldSpread, out.coverage, out.offset);
+                return true;
+            };
+
+            atlas.rasterize = [this](uint32_t codepoint, GlyphAtlas::Bitmap& out) {
+                return rasterizeAny(codepoint, out);
+            };
+        }
+
+        // the glyph from this font, or the first fallback that has it
+        bool rasterizeAny(uint32_t codepoint, GlyphAtlas::Bitmap& out) const {
+            if (rasterizeOwn(codepoint, out))
+                return true;
+
+            for (const Font* fallback : fallbacks) {
+                if (fallback->rasterizeOwn(codepoint, out)) {
+                    out.offset.y += ascent - fallback->ascent;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool rasterizeOwn(uint32_t codepoint, GlyphAtlas::Bitmap& out) const {
+#ifdef _WIN32
+            if (!face.ok())
+                return rasterizeGlyph(codepoint, out);
+#endif
+            int glyph = face.glyphIndex(codepoint);
+            if (glyph == 0)
+                return false;
+
+            float scale = (float)size / face.unitsPerEm;
+            out.advance = (int)std::lround(face.advance(glyph) * scale);
+
+            ivec2 offset;
+            if (face.rasterize(glyph, scale, out.coverage, offset))
+                out.offset = { offset.x, ascent + offset.y };
+            return true;
+        }
+
+#ifdef _WIN32
+        // one glyph's 65 level GDI coverage, scaled up to 0..255
+        bool rasterizeGlyph(uint32_t codepoint, GlyphAtlas::Bitmap& out) const {
+            if (!hdc || codepoint > 0xFFFF)
+                return false;
+
+            // missing ones go to the fallbacks instead of drawing a box
+            WORD index = 0;
+            WCHAR unit = (WCHAR)codepoint;
+            if (GetGlyphIndicesW(hdc, &unit, 1, &index, GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR || index == 0xFFFF)
+                return false;
+
+            const MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+            GLYPHMETRICS gm{};
+
+            DWORD bytes = GetGlyphOutlineW(hdc, (UINT)codepoint, GGO_GRAY8_BITMAP, &gm, 0, nullptr, &identity);
+            if (bytes == GDI_ERROR)
+                return false;
+
+            out.advance = gm.gmCellIncX;
+            out.offset = { gm.gmptGlyphOrigin.x, ascent - gm.gmptGlyphOrigin.y };
+
+            // blank glyphs (space) have an advance and nothing to draw
+            if (bytes == 0)
+                return true;
+
+            thread_local std::vector<uint8_t> buffer;
+            buffer.resize(bytes);
+            if (GetGlyphOutlineW(hdc, (UINT)codepoint, GGO_GRAY8_BITMAP, &gm, bytes, buffer.data(), &identity) == GDI_ERROR)
+                return false;
+
+            int width = (int)gm.gmBlackBoxX;
+            int height = (int)gm.gmBlackBoxY;
+            int pitch = (width + 3) & ~3; // GDI rows are DWORD aligned
+
+            out.coverage = MaskSurface({ (float)width, (float)height });
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    out.coverage.row(y)[x] = (uint8_t)std::min(255, buffer[(size_t)y * pitch + x] * 255 / 64);
+
+            return true;
+        }
+#endif
+
+    public:
+        // text on its own premultiplied surface, for keeping. To put text on
+        // screen draw() is cheaper, it needs neither the surface nor the blit.
+        Surface render(const std::string& text, vec3 textColour, vec4 bgColour) {
+            WINHELP_PROFILE_SCOPE("Font::render");
+
+            MaskSurface cover = renderMask(text);
+            Surface result({ (float)cover.size.x, (float)cover.size.y });
+
+            for (int y = 0; y < cover.size.y; ++y) {
+                const uint8_t* src = cover.row(y);
+                uint32_t* dst = result.row(y);
+
+                for (int x = 0; x < cover.size.x; ++x) {
+                    uint8_t coverage = src[x];
+
+                    if (coverage) {
+
+                        uint32_t a = coverage;
+
+                        uint32_t r =
+                            ((uint32_t)textColour.x * a) >> 8;
+                        uint32_t g =
+                            ((uint32_t)textColour.y * a) >> 8;
+                        uint32_t b =
+                            ((uint32_t)textColour.z * a) >> 8;
+
+                        dst[x] =
+                            (a << 24) |
+                            (r << 16) |
+                            (g << 8)  |
+                            b;
+
+                    } else {
+
+                        if (bgColour.w != 0) {
+
+                            uint32_t a = (uint32_t)bgColour.w;
+
+                            uint32_t r =
+                                ((uint32_t)bgColour.x * a) >> 8;
+                            uint32_t g =
+                                ((uint32_t)bgColour.y * a) >> 8;
+                            uint32_t b =
+                                ((uint32_t)bgColour.z * a) >> 8;
+
+                            dst[x] =
+                                (a << 24) |
+                                (r << 16) |
+                                (g << 8)  |
+                                b;
+
+                        } else {
+                            dst[x] = 0;
+                        }
+                    }
+                }
+            }
+            result.hasAlpha = true;
+            return result;
+        }
+
+        // just the coverage, 1 byte a pixel, for draw::blit_mask in any colour.
+        // Lines break at '\n' and, given a wrapWidth, between words to fit it.
+        MaskSurface renderMask(std::string_view text, int wrapWidth = 0) const {
+            WINHELP_PROFILE_SCOPE("Font::renderMask");
+
+            thread_local std::vector<std::pair<size_t, size_t>> lines;
+            lines.clear();
+            atlas.wrap(text, wrapWidth, lines);
+
+            int width = 0;
+            for (auto [begin, end] : lines)
+                width = std::max(width, atlas.measure(text.substr(begin, end - begin)).x);
+
+            MaskSurface result({ (float)width, (float)(atlas.lineHeight * (int)lines.size()) });
+            for (size_t i = 0; i < lines.size(); ++i)
+                atlas.coverage(result, { 0, atlas.lineHeight * (int)i },
+                    text.substr(lines[i].first, lines[i].second - lines[i].first));
+            return result;
+        }
+
+        // the box render/renderMask make for text, lines and all
+        ivec2 sizeOf(std::string_view text, int wrapWidth = 0) const {
+            return extent(text, wrapWidth);
+        }
+
+        // size of text laid out like renderMask/draw: the widest line by the
+        // lines' height. Every glyph it needs is loaded after this.
+        ivec2 extent(std::string_view text, int wrapWidth = 0) const {
+            thread_local std::vector<std::pair<size_t, size_t>> lines;
+            lines.clear();
+            return extent(text, wrapWidth, lines);
+        }
+
+        // the same, with where it broke text into lines appended to lines
+        ivec2 extent(std::string_view text, int wrapWidth, std::vector<std::pair<size_t, size_t>>& lines) const {
+            size_t first = lines.size();
+            atlas.wrap(text, wrapWidth, lines);
+
+            int width = 0;
+            for (size_t i = first; i < lines.size(); ++i)
+                width = std::max(width, atlas.measure(text.substr(lines[i].first, lines[i].second - lines[i].first)).x);
+            return { width, atlas.lineHeight * (int)(lines.size() - first) };
+        }
+
+        // text straight into target, laid out like renderMask with its top
+        // left at position: no surface in between and no second pass, each
+        // glyph's coverage is blended into the clip as it's found, lines
+        // outside the clip are skipped.
+        void draw(SurfaceView target, vec2 position, std::string_view text, vec4 colour,
+            int wrapWidth = 0, blend_mode mode = blend_mode::alpha) const {
+
+            WINHELP_PROFILE_SCOPE("Font::draw");
+
+            irect clip = target.clipRect();
+            int height = atlas.lineHeight;
+            if (clip.empty() || colour.w <= 0 || position.y >= clip.y1)
+                return;
+
+            // the common case, one line
+            if (wrapWidth <= 0 && text.find('\n') == std::string_view::npos) {
+                atlas.draw(target, position, text, colour, mode);
+                return;
+            }
+
+            thread_local std::vector<std::pair<size_t, size_t>> lines;
+            lines.clear();
+            atlas.wrap(text, wrapWidth, lines);
+
+            for (size_t i = 0; i < lines.size(); ++i) {
+                float y = position.y + (float)(height * (int)i);
+                if (y >= clip.y1)
+                    break;
+                if (y + height <= clip.y0)
+                    continue;
+
+                atlas.draw(target, { position.x, y }, text.substr(lines[i].first, lines[i].second - lines[i].first),
+                    colour, mode);
+            }
+        }
+
+        // draw for text extent() has already broken into lines (count pairs
+        // of byte offsets into text), from the glyphs that loaded. It loads
+        // none, a glyph that isn't there is left out, so several threads can
+        // draw from the font at once. Nothing may measure, draw or resize the
+        // font on another thread meanwhile, that loads glyphs under them.
+        void drawLines(SurfaceView target, vec2 position, std::string_view text,
+            const std::pair<size_t, size_t>* lines, size_t count, vec4 colour,
+            blend_mode mode = blend_mode::alpha) const {
+
+            irect clip = target.clipRect();
+            int height = atlas.lineHeight;
+            if (clip.empty() || colour.w <= 0)
+                return;
+
+            for (size_t i = 0; i < count; ++i) {
+                float y = position.y + (float)(height * (int)i);
+                if (y >= clip.y1)
+                    break;
+                if (y + height <= clip.y0)
+                    continue;
+
+                atlas.drawLoaded(target, { position.x, y }, text.substr(lines[i].first, lines[i].second - lines[i].first),
+                    colour, mode);
+            }
+        }
+
+        // the cached glyphs, for measuring and wrapping without the font
+        GlyphAtlas& glyphs() {
+            return atlas;
+        }
+
+        // text at any pixel size from one distance field per glyph, made the
+        // first time the glyph is drawn this way and kept for as long as the
+        // font. Zooming stays smooth and rasterizes nothing again. Only
+        // TrueType fonts have the outlines for it, a GDI font draws nothing.
+        void drawScaled(SurfaceView target, vec2 position, const std::string& text, float pixelSize,
+            vec4 colour, blend_mode mode = blend_mode::alpha) const {
+
+            WINHELP_PROFILE_SCOPE("Font::drawScaled");
+
+            uint32_t alpha = (uint32_t)std::clamp(colour.w, 0.0f, 255.0f);
+            irect clip = target.clipRect();
+            if (!face.ok() || alpha == 0 || pixelSize <= 0 || clip.empty())
+                return;
+
+            float units = pixelSize / face.unitsPerEm; // target pixels per font unit
+            float k = pixelSize / fieldSize;           // and per field pixel
+            float baseline = position.y + face.ascent * units;
+            if (position.y >= clip.y1 || baseline - face.descent * units <= clip.y0)
+                return;
+
+            // field bytes to target pixels of distance, positive inside
+            float slope = fieldSpread / 127.0f * k;
+            uint32_t packed = draw::pack_colour(vec3(colour));
+            internal_blend::mask_fn maskRow = internal_blend::pick_mask(mode);
+
+            thread_local std::vector<int> columns;
+            thread_local std::vector<float> fractions;
+            thread_local std::vector<uint8_t> coverage;
+
+            float x = position.x;
+            int previous = 0;
+
+            utf8::for_each(text, [&](uint32_t c, size_t) {
+                int glyph = face.glyphIndex(c);
+                if (glyph == 0) {
+                    previous = 0;
+                    return;
+                }
+
+                if (previous)
+                    x += face.kerning(previous, glyph) * units;
+                previous = glyph;
+
+                const GlyphAtlas::Glyph& g = fields.glyph(c);
+                float gx = x + g.offset.x * k;
+                float gy = baseline + g.offset.y * k;
+                x += face.advance(glyph) * units;
+
+                int x0 = std::max(clip.x0, (int)std::floor(gx));
+                int x1 = std::min(clip.x1, (int)std::ceil(gx + g.size.x * k));
+                int y0 = std::max(clip.y0, (int)std::floor(gy));
+                int y1 = std::min(clip.y1, (int)std::ceil(gy + g.size.y * k));
+                if (g.size.x < 2 || g.size.y < 2 || x0 >= x1 || y0 >= y1)
+                    return;
+
+                // where every target column samples the field, once per glyph
+                int count = x1 - x0;
+                columns.resize(count);
+                fractions.resize(count);
+                coverage.resize(count);
+                for (int i = 0; i < count; ++i) {
+                    float u = std::clamp((x0 + i + 0.5f - gx) / k - 0.5f, 0.0f, (float)(g.size.x - 1));
+                    columns[i] = std::min((int)u, g.size.x - 2);
+                    fractions[i] = u - columns[i];
+                }
+
+                for (int y = y0; y < y1; ++y) {
+                    float v = std::clamp((y + 0.5f - gy) / k - 0.5f, 0.0f, (float)(g.size.y - 1));
+                    int vi = std::min((int)v, g.size.y - 2);
+                    float fv = v - vi;
+                    const uint8_t* r0 = fields.sheet.row(g.pos.y + vi) + g.pos.x;
+                    const uint8_t* r1 = r0 + fields.sheet.pitch;
+
+                    for (int i = 0; i < count; ++i) {
+                        int u = columns[i];
+                        float fu = fractions[i];
+                        float a = r0[u] + (r0[u + 1] - r0[u]) * fu;
+                        float b = r1[u] + (r1[u + 1] - r1[u]) * fu;
+                        float distance = (a + (b - a) * fv - 128.0f) * slope;
+                        coverage[i] = (uint8_t)(std::clamp(distance + 0.5f, 0.0f, 1.0f) * 255.0f + 0.5f);
+                    }
+
+                    maskRow(target.row(y) + x0, coverage.data(), count, packed, alpha);
+                }
+            });
+        }
+
+        // the box drawScaled fills, fractional like the size
+        vec2 sizeScaled(const std::string& text, float pixelSize) const {
+            if (!face.ok())
+                return { 0, 0 };
+
+            float units = pixelSize / face.unitsPerEm;
+            float width = 0;
+            int previous = 0;
+
+            utf8::for_each(text, [&](uint32_t c, size_t) {
+                int glyph = face.glyphIndex(c);
+                if (glyph == 0) {
+                    previous = 0;
+                    return;
+                }
+                if (previous)
+                    width += face.kerning(previous, glyph) * units;
+                width += face.advance(glyph) * units;
+                previous = glyph;
+            });
+
+            return { width, (face.ascent - face.descent) * units };
+        }
+
+        // a TrueType font rasterizes its glyphs again at the new size (the
+        // distance fields don't care), a GDI one only remembers it
+        void setSize(int newSize) {
             size = newSize;
-            surface = Surface(newSize);
+            if (!face.ok())
+                return;
 
-            SetWindowPos(
-                handle,
-                nullptr,
-                0, 0,
-                (int)newSize.x,
-                (int)newSize.y,
-                SWP_NOMOVE | SWP_NOZORDER
-            );
+            lineHeight = faceHeight(face, size);
+            atlas.clear();
+            atlas.clearKerning();
+            useFace();
+            generation++;
+        }
 
-            configure_bitmap();
+        // changes when the same text would come out different, for caches of rendered text
+        uint32_t version() const {
+            return generation;
         }
+    };
 
-        void set_title(std::string newTitle) {
-            title = newTitle;
-            std::wstring wideTitle(newTitle.begin(), newTitle.end());
-            SetWindowTextW(handle, wideTitle.c_str());
+    // Text laid out into lines once and kept: wrapped to a width, aligned,
+    // every line's extent measured and cached. The text is a list of
+    // paragraphs (what '\n' separates) and an edit only lays out the
+    // paragraphs it touches again, so a console with tens of thousands of
+    // lines appends and redraws without going over the rest. Drawing starts
+    // at the first line inside the clip and stops after the last.
+    class TextLayout {
+    public:
+        enum class align { left, centre, right };
+
+        struct Line {
+            uint32_t begin, end; // bytes of its paragraph
+            int width;
+        };
+
+        explicit TextLayout(Font& layoutFont, int wrapWidth = 0, align alignment = align::left)
+            : font(layoutFont), wrap(wrapWidth), alignment(alignment), version(layoutFont.version()) {
+            paragraphs.emplace_back();
         }
 
-        void flip() {
-            if (!handle) return;
-            HDC dc = GetDC(handle);
+        void setText(std::string_view text) {
+            paragraphs.clear();
+            paragraphs.emplace_back();
+            firstDirty = 0;
+            append(text);
+        }
 
-            StretchDIBits(
-                dc,
-                0, 0,
-                (int)size.x,
-                (int)size.y,
-                0, 0,
-                (int)size.x,
-                (int)size.y,
-                surface.pixels.data(),
-                &bitmapInfo,
-                DIB_RGB_COLORS,
-                SRCCOPY
-            );
+        // onto the end of the last paragraph, every '\n' starting a new one
+        void append(std::string_view text) {
+            size_t begin = 0;
+            while (true) {
+                size_t end = std::min(text.find('\n', begin), text.size());
+                Paragraph& last = paragraphs.back();
+                last.text.append(text.substr(begin, end - begin));
+                last.dirty = true;
+                markFrom(paragraphs.size() - 1);
+
+                if (end == text.size())
+                    return;
+                paragraphs.emplace_back();
+                begin = end + 1;
+            }
+        }
+
+        // text as paragraphs of its own before paragraph `at` (paragraphCount() for the end)
+        void insertParagraphs(size_t at, std::string_view text) {
+            at = std::min(at, paragraphs.size());
+            markFrom(at);
+            size_t begin = 0;
+            while (true) {
+                size_t end = std::min(text.find('\n', begin), text.size());
+                Paragraph p;
+                p.text = std::string(text.substr(begin, end - begin));
+                paragraphs.insert(paragraphs.begin() + at++, std::move(p));
+
+                if (end == text.size())
+                    return;
+                begin = end + 1;
+            }
+        }
+
+        void setParagraph(size_t index, std::string_view text) {
+            if (index >= paragraphs.size())
+                return;
+            paragraphs[index].text = std::string(text);
+            paragraphs[index].dirty = true;
+            markFrom(index);
+        }
+
+        // there is always at least one paragraph, maybe empty
+        void eraseParagraphs(size_t at, size_t count = 1) {
+            if (at >= paragraphs.size())
+                return;
+            count = std::min(count, paragraphs.size() - at);
+            paragraphs.erase(paragraphs.begin() + at, paragraphs.begin() + at + count);
+            if (paragraphs.empty())
+                paragraphs.emplace_back();
+            markFrom(at);
+        }
 
-            ReleaseDC(handle, dc);
+        const std::string& paragraph(size_t index) const {
+            return paragraphs[index].text;
         }
 
-        void close() {
-            DestroyWindow(handle);
-            handle = nullptr;
+        size_t paragraphCount() const {
+            return paragraphs.size();
         }
-    };
 
-    class Font {
-    private:
-        HFONT hfont;
-        HDC   hdc;
-        HBITMAP hdib;
-        void* bits;
-        int   size;
-        std::wstring name;
+        // every line wraps differently, all of it is laid out again
+        void setWrapWidth(int width) {
+            if (width == wrap)
+                return;
+            wrap = width;
+            dirtyAll();
+        }
 
-    public:
-        const int lineHeight;
+        // lines only move sideways, nothing is laid out again
+        void setAlignment(align a) {
+            alignment = a;
+        }
 
-        Font(int fontSize = 16, const std::wstring& fontName = L"Consolas") 
-        : hfont(nullptr),
-        hdc(nullptr),
-        hdib(nullptr),
-        bits(nullptr),
-        size(fontSize),
-        name(fontName),
-        lineHeight([&]() { // yes i hate you, what you gona do about it?
-            SetMapMode(hdc, MM_TEXT);
-            SetGraphicsMode(hdc, GM_COMPATIBLE);
+        // the wrapped lines of one paragraph
+        const std::vector<Line>& lines(size_t paragraph) {
+            update();
+            return paragraphs[paragraph].lines;
+        }
 
-            HFONT tempFont = CreateFontW(
-                -fontSize,
-                0, 0, 0,
-                FW_NORMAL,
-                FALSE, FALSE, FALSE,
-                DEFAULT_CHARSET,
-                OUT_DEFAULT_PRECIS,
-                CLIP_DEFAULT_PRECIS,
-                ANTIALIASED_QUALITY,
-                DEFAULT_PITCH | FF_DONTCARE,
-                fontName.c_str()
-            );
+        size_t lineCount() {
+            update();
+            return totalLines;
+        }
 
-            SelectObject(hdc, tempFont);
+        ivec2 size() {
+            update();
+            return { wrap > 0 ? wrap : widest, (int)totalLines * font.lineHeight };
+        }
 
-            TEXTMETRIC tm{};
-            int h = fontSize;
-            if (GetTextMetrics(hdc, &tm))
-                h = tm.tmHeight;
+        // lines wrapped and measured since the layout was made, to see edits stay local
+        size_t linesLaidOut() const {
+            return laidOut;
+        }
 
-            DeleteObject(tempFont);
-            return h;
-        }()) {
-            hdc = CreateCompatibleDC(nullptr);
+        void draw(SurfaceView target, vec2 position, vec4 colour, blend_mode mode = blend_mode::alpha) {
+            WINHELP_PROFILE_SCOPE("TextLayout::draw");
 
-            SetMapMode(hdc, MM_TEXT);
-            SetGraphicsMode(hdc, GM_COMPATIBLE);
+            update();
 
-            hfont = CreateFontW(
-                -size,
-                0, 0, 0,
-                FW_NORMAL,
-                FALSE, FALSE, FALSE,
-                DEFAULT_CHARSET,
-                OUT_DEFAULT_PRECIS,
-                CLIP_DEFAULT_PRECIS,
-                ANTIALIASED_QUALITY,
-                DEFAULT_PITCH | FF_DONTCARE,
-                name.c_str()
-            );
+            irect clip = target.clipRect();
+            int lineHeight = font.lineHeight;
+            if (clip.empty() || lineHeight <= 0)
+                return;
 
-            SelectObject(hdc, hfont);
-        }
+            // the lines the clip can see, then the paragraph holding the first
+            int64_t first = std::max<int64_t>(0, (int64_t)std::floor((clip.y0 - position.y) / lineHeight));
+            int64_t last = std::min<int64_t>((int64_t)totalLines, (int64_t)std::ceil((clip.y1 - position.y) / lineHeight));
+            if (first >= last)
+                return;
 
-        ~Font() {
-            if (hfont) {
-                DeleteObject(hfont);
-                hfont = nullptr;
-            }
-            if (hdib) {
-                DeleteObject(hdib);
-                hdib = nullptr;
-            }
-            if (hdc) {
-                DeleteDC(hdc);
-                hdc = nullptr;
+            auto it = std::upper_bound(paragraphs.begin(), paragraphs.end(), (uint32_t)first,
+                [](uint32_t line, const Paragraph& p) { return line < p.firstLine; });
+            size_t index = (size_t)(it - paragraphs.begin()) - 1;
+
+            int box = wrap > 0 ? wrap : widest;
+            GlyphAtlas& glyphs = font.glyphs();
+
+            for (; index < paragraphs.size() && paragraphs[index].firstLine < last; ++index) {
+                const Paragraph& p = paragraphs[index];
+
+                for (size_t i = 0; i < p.lines.size(); ++i) {
+                    int64_t line = (int64_t)p.firstLine + (int64_t)i;
+                    if (line < first)
+                        continue;
+                    if (line >= last)
+                        break;
+
+                    const Line& l = p.lines[i];
+                    float x = position.x;
+                    if (alignment == align::centre)
+                        x += (float)((box - l.width) / 2);
+                    else if (alignment == align::right)
+                        x += (float)(box - l.width);
+
+                    glyphs.draw(target, { x, position.y + (float)(line * lineHeight) },
+                        std::string_view(p.text).substr(l.begin, l.end - l.begin), colour, mode);
+                }
             }
         }
 
-        Surface render(const std::string& text, vec3 textColour, vec4 bgColour) {
-            SIZE textSize{};
-            GetTextExtentPoint32A(hdc, text.c_str(),
-                                (int)text.length(), &textSize);
+    private:
+        struct Paragraph {
+            std::string text;
+            std::vector<Line> lines;
+            uint32_t firstLine = 0; // of the whole layout
+            int widest = 0;
+            bool dirty = true;
+        };
 
-            Surface result({ (float)textSize.cx,
-                            (float)textSize.cy });
+        Font& font;
+        int wrap;
+        align alignment;
+        uint32_t version;
 
-            if (textSize.cx == 0 || textSize.cy == 0)
-                return result;
+        std::vector<Paragraph> paragraphs;
+        size_t firstDirty = 0; // paragraphs from here on need firstLine redone, SIZE_MAX when none do
+        size_t totalLines = 0;
+        int widest = 0;
+        size_t laidOut = 0;
+
+        void markFrom(size_t index) {
+            firstDirty = std::min(firstDirty, index);
+        }
 
-            // Create DIB
-            BITMAPINFOHEADER bih{};
-            bih.biSize = sizeof(BITMAPINFOHEADER);
-            bih.biWidth = textSize.cx;
-            bih.biHeight = -textSize.cy;
-            bih.biPlanes = 1;
-            bih.biBitCount = 32;
-            bih.biCompression = BI_RGB;
+        void dirtyAll() {
+            for (Paragraph& p : paragraphs)
+                p.dirty = true;
+            firstDirty = 0;
+        }
 
-            if (hdib) DeleteObject(hdib);
-            hdib = CreateDIBSection(hdc, (BITMAPINFO*)&bih, DIB_RGB_COLORS, &bits, nullptr, 0);
-            if (!hdib || !bits) {
-                return result;
+        void update() {
+            if (font.version() != version) {
+                version = font.version();
+                dirtyAll();
             }
-            SelectObject(hdc, hdib);
+            if (firstDirty == SIZE_MAX)
+                return;
 
-            // Clear DIB
-            RECT rect = { 0, 0, textSize.cx, textSize.cy };
-            HBRUSH clearBrush = (HBRUSH)GetStockObject(BLACK_BRUSH);
-            FillRect(hdc, &rect, clearBrush);
+            thread_local std::vector<std::pair<size_t, size_t>> breaks;
+            GlyphAtlas& glyphs = font.glyphs();
 
-            SetBkMode(hdc, TRANSPARENT);
-            SetTextColor(hdc, RGB(255, 255, 255));
+            size_t line = 0;
+            if (firstDirty > 0 && firstDirty <= paragraphs.size()) {
+                const Paragraph& before = paragraphs[firstDirty - 1];
+                line = before.firstLine + before.lines.size();
+            }
 
-            TextOutA(hdc, 0, 0,
-                    text.c_str(),
-                    (int)text.length());
+            for (size_t i = std::min(firstDirty, paragraphs.size()); i < paragraphs.size(); ++i) {
+                Paragraph& p = paragraphs[i];
 
-            // Read pixels from DIB
-            uint32_t* src =
-                reinterpret_cast<uint32_t*>(bits);
+                if (p.dirty) {
+                    breaks.clear();
+                    glyphs.wrap(p.text, wrap, breaks);
 
-            size_t total =
-                (size_t)textSize.cx *
-                (size_t)textSize.cy;
+                    p.lines.clear();
+                    p.widest = 0;
+                    for (auto [begin, end] : breaks) {
+                        int width = glyphs.measure(std::string_view(p.text).substr(begin, end - begin)).x;
+                        p.lines.push_back({ (uint32_t)begin, (uint32_t)end, width });
+                        p.widest = std::max(p.widest, width);
+                    }
 
-            for (size_t i = 0; i < total; ++i) {
+                    laidOut += p.lines.size();
+                    p.dirty = false;
+                }
 
-                uint32_t pixel = src[i];
+                p.firstLine = (uint32_t)line;
+                line += p.lines.size();
+            }
 
-                // GDI text is grayscale in R channel
-                uint8_t coverage = (pixel >> 16) & 0xFF;
+            totalLines = line;
+            firstDirty = SIZE_MAX;
 
-                if (coverage) {
+            // the box to align in, only needed without a wrap width
+            widest = 0;
+            if (wrap <= 0)
+                for (const Paragraph& p : paragraphs)
+                    widest = std::max(widest, p.widest);
+        }
+    };
 
-                    uint32_t a = coverage;
+    // Text kept rendered between frames: a label drawn every frame is laid
+    // out and rasterized once, after that it is one blit_mask for as long as
+    // it doesn't change. Entries are coverage keyed on the font, the text and
+    // the wrap width; the colour goes on while blitting, so recolouring a
+    // label (hover, fades) still hits. Past the byte budget the least recently
+    // drawn entries go first.
+    class TextCache {
+    public:
+        struct Counters {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+        };
 
-                    uint32_t r =
-                        ((uint32_t)textColour.x * a) >> 8;
-                    uint32_t g =
-                        ((uint32_t)textColour.y * a) >> 8;
-                    uint32_t b =
-                        ((uint32_t)textColour.z * a) >> 8;
+        explicit TextCache(size_t budgetBytes = 8 << 20) : budget(budgetBytes) {}
 
-                    result.pixels[i] =
-                        (a << 24) |
-                        (r << 16) |
-                        (g << 8)  |
-                        b;
+        // entries point at their font, the cache can't be copied around with them
+        TextCache(const TextCache&) = delete;
+        TextCache& operator=(const TextCache&) = delete;
 
-                } else {
+        // text's coverage, rendered now if it isn't cached. Lasts until the next call.
+        const MaskSurface& get(const Font& font, std::string_view text, int wrapWidth = 0) {
+            auto it = index.find(Key{ &font, font.version(), wrapWidth, text });
+            if (it != index.end()) {
+                stats.hits++;
+                entries.splice(entries.begin(), entries, it->second);
+                return it->second->mask;
+            }
 
-                    if (bgColour.w != 0) {
+            stats.misses++;
+            entries.push_front({ &font, font.version(), wrapWidth, std::string(text), font.renderMask(text, wrapWidth) });
+            Entry& entry = entries.front();
+            used += cost(entry);
+            index.emplace(Key{ entry.font, entry.version, entry.wrap, entry.text }, entries.begin());
 
-                        uint32_t a = (uint32_t)bgColour.w;
+            trim();
+            return entry.mask;
+        }
 
-                        uint32_t r =
-                            ((uint32_t)bgColour.x * a) >> 8;
-                        uint32_t g =
-                            ((uint32_t)bgColour.y * a) >> 8;
-                        uint32_t b =
-                            ((uint32_t)bgColour.z * a) >> 8;
+        void draw(SurfaceView target, const Font& font, vec2 position, std::string_view text, vec4 colour,
+            int wrapWidth = 0, blend_mode mode = blend_mode::alpha) {
 
-                        result.pixels[i] =
-                            (a << 24) |
-                            (r << 16) |
-                            (g << 8)  |
-                            b;
+            WINHELP_PROFILE_SCOPE("TextCache::draw");
+            draw::blit_mask(target, get(font, text, wrapWidth), position, colour, mode);
+        }
 
-                    } else {
-                        result.pixels[i] = 0;
-                    }
-                }
+        Counters counters() const {
+            return stats;
+        }
+
+        void resetCounters() {
+            stats = {};
+        }
+
+        size_t bytes() const {
+            return used;
+        }
+
+        size_t size() const {
+            return entries.size();
+        }
+
+        void setBudget(size_t budgetBytes) {
+            budget = budgetBytes;
+            trim();
+        }
+
+        // drop everything of a font before it goes away, its address may come back as another font
+        void forget(const Font& font) {
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (it->font == &font)
+                    it = erase(it);
+                else
+                    ++it;
             }
-            result.hasAlpha = true;
-            return result;
         }
 
-        ivec2 sizeOf(const std::string& text) const {
-            if (!hdc)
-                return { 0, 0 };
+        void clear() {
+            index.clear();
+            entries.clear();
+            used = 0;
+        }
 
-            SIZE textSize{};
-            if (!GetTextExtentPoint32A(
-                    hdc,
-                    text.c_str(),
-                    (int)text.length(),
-                    &textSize))
-            {
-                return { 0, 0 };
+    private:
+        struct Entry {
+            const Font* font;
+            uint32_t version;
+            int wrap;
+            std::string text;
+            MaskSurface mask;
+        };
+
+        // text points into the entry's own string (or the caller's, looking up)
+        struct Key {
+            const Font* font;
+            uint32_t version;
+            int wrap;
+            std::string_view text;
+
+            bool operator==(const Key& other) const {
+                return font == other.font && version == other.version && wrap == other.wrap && text == other.text;
             }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                // mixed in 64 bits and folded down, size_t is 32 on win32
+                uint64_t h = std::hash<std::string_view>()(key.text);
+                h ^= std::hash<const void*>()(key.font) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+                h ^= ((uint64_t)key.version << 32 | (uint32_t)key.wrap) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+                return (size_t)(h ^ (h >> 32));
+            }
+        };
 
-            return { textSize.cx, textSize.cy };
+        std::list<Entry> entries; // most recently drawn first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t budget;
+        size_t used = 0;
+        Counters stats;
+
+        static size_t cost(const Entry& entry) {
+            return entry.mask.pixels.size() + entry.text.size() + sizeof(Entry);
         }
 
-        void inline setSize(const int newSize) {
-            size = newSize;
+        std::list<Entry>::iterator erase(std::list<Entry>::iterator it) {
+            index.erase(Key{ it->font, it->version, it->wrap, it->text });
+            used -= cost(*it);
+            return entries.erase(it);
+        }
+
+        // the newest entry stays even over budget, get() is handing it out
+        void trim() {
+            while (used > budget && entries.size() > 1) {
+                erase(std::prev(entries.end()));
+                stats.evictions++;
+            }
         }
     };
 
     namespace draw {
+        // Draw calls recorded instead of drawn: fills, rects, circles, lines,
+        // blits and text kept as small plain entries until submit(target).
+        // Submitting sorts them into tiles of the target and draws the tiles on
+        // the job threads, each tile's commands in the order they were recorded,
+        // so the pixels are the same as drawing them straight away. Whatever a
+        // later fill or filled rect covers in a tile isn't drawn there at all.
+        // A buffer can be submitted again and again without recording it again
+        // (the tiles are only sorted again when the target or the commands
+        // change), and the next frame can be recorded into another buffer
+        // while one is submitted on another thread.
+        // Blit sources and fonts are pointed at, not copied, they have to stay
+        // around (and unchanged) as long as the buffer is submitted. Text is
+        // wrapped and its glyphs loaded when it's recorded, the tiles only read
+        // the font, but measuring or drawing text loads glyphs into it: a font
+        // a buffer is submitting with can't be drawn with, measured or recorded
+        // (into any buffer) on another thread until submit() returns.
+        class CommandBuffer {
+        public:
+            CommandBuffer() {
+                clips.push_back(everything());
+            }
 
-        inline uint32_t pack_colour(vec3 c, uint8_t a = 255) {
-            return (uint32_t(a) << 24) |
-                (uint32_t(c.x) << 16) |
-                (uint32_t(c.y) << 8)  |
-                uint32_t(c.z);
-        }
+            void fill(vec4 colour) {
+                add(op::fill, Surface::pack(colour), everything());
+            }
 
-        inline void put_pixel(Surface& surface, int x, int y, vec3 colour) {
-            if (x < 0 || y < 0 || x >= surface.size.x || y >= surface.size.y)
-                return;
+            void rect(vec2 pos, vec2 size, vec3 colour, bool filled = true, float thickness = 1.0f) {
+                if (!filled) {
+                    // the four lines draw::rect would draw
+                    line(pos, { pos.x + size.x, pos.y }, colour, thickness);
+                    line({ pos.x + size.x, pos.y }, { pos.x + size.x, pos.y + size.y }, colour, thickness);
+                    line({ pos.x + size.x, pos.y + size.y }, { pos.x, pos.y + size.y }, colour, thickness);
+                    line({ pos.x, pos.y + size.y }, pos, colour, thickness);
+                    return;
+                }
 
-            surface.pixels[(size_t)y * surface.size.x + x] =
-                pack_colour(colour);
-        }
+                int x = (int)pos.x;
+                int y = (int)pos.y;
+                Command* c = add(op::rect, pack_colour(colour), irect(x, y, x + (int)size.x, y + (int)size.y));
+                if (!c)
+                    return;
 
-        // Alpha blended pixel write (for font blitting etc.)
-        inline void put_pixel_alpha(Surface& surface, int x, int y, uint32_t src) {
-            if (x < 0 || y < 0 || x >= surface.size.x || y >= surface.size.y)
-                return;
+                c->x0 = pos.x; c->y0 = pos.y;
+                c->x1 = size.x; c->y1 = size.y;
+            }
 
-            uint32_t& dst = surface.pixels[(size_t)y * surface.size.x + x];
+            void circle(vec2 center, int radius, vec3 colour, bool filled = true) {
+                if (radius < 0)
+                    return;
 
-            uint32_t srcA = src >> 24;
+                int x = (int)center.x;
+                int y = (int)center.y;
+                Command* c = add(filled ? op::circle : op::ring, pack_colour(colour),
+                    irect(x - radius, y - radius, x + radius + 1, y + radius + 1));
+                if (!c)
+                    return;
 
-            if (srcA == 255) {
-                dst = src;
-                return;
+                c->x0 = center.x; c->y0 = center.y;
+                c->value = radius;
             }
 
-            if (srcA == 0)
-                return;
-
-            uint32_t dstRB = dst & 0x00FF00FF;
-            uint32_t dstG  = dst & 0x0000FF00;
+            void line(vec2 start, vec2 end, vec3 colour, float thickness = 1.0f, cap lineCap = cap::square) {
+                // a thick line's caps reach at most its thickness past the ends
+                float pad = thickness > 1.0f ? thickness + 1.0f : 1.0f;
+                Command* c = add(thickness > 1.0f ? op::stroke : op::line, pack_colour(colour),
+                    irect(whole(std::min(start.x, end.x) - pad), whole(std::min(start.y, end.y) - pad),
+                          whole(std::max(start.x, end.x) + pad) + 1, whole(std::max(start.y, end.y) + pad) + 1));
+                if (!c)
+                    return;
+
+                c->x0 = start.x; c->y0 = start.y;
+                c->x1 = end.x; c->y1 = end.y;
+                c->width = thickness;
+                c->mode = (uint8_t)lineCap;
+            }
 
-            uint32_t srcRB = src & 0x00FF00FF;
-            uint32_t srcG  = src & 0x0000FF00;
+            void blit(const SourceView& source, vec2 position, blend_mode mode = blend_mode::alpha, int opacity = 255) {
+                opacity = std::clamp(opacity, 0, 255);
+                if (opacity == 0)
+                    return;
+
+                int x = (int)position.x;
+                int y = (int)position.y;
+                Command* c = add(op::blit, 0, irect(x, y, x + source.size.x, y + source.size.y));
+                if (!c)
+                    return;
+
+                c->x0 = position.x; c->y0 = position.y;
+                c->mode = (uint8_t)mode;
+                c->value = opacity;
+                c->ref = (uint32_t)sources.size();
+                sources.push_back(source);
+            }
 
-            uint32_t invA = 255 - srcA;
+            // like font.draw(target, position, text, colour, wrapWidth, mode)
+            void text(const Font& font, vec2 position, std::string_view text, vec4 colour,
+                int wrapWidth = 0, blend_mode mode = blend_mode::alpha) {
+
+                if (text.empty() || colour.w <= 0)
+                    return;
+
+                // broken into lines (loading every glyph) once, here
+                size_t first = lines.size();
+                ivec2 extent = font.extent(text, wrapWidth, lines);
+                Command* c = add(op::text, Surface::pack(vec4(colour.x, colour.y, colour.z, std::min(colour.w, 255.0f))),
+                    text_bounds(font, position, extent));
+                if (!c) {
+                    lines.resize(first);
+                    return;
+                }
 
-            // multiply packed channels
-            dstRB = (dstRB * invA) >> 8;
-            dstG  = (dstG  * invA) >> 8;
+                for (size_t i = first; i < lines.size(); ++i) {
+                    lines[i].first += bytes.size();
+                    lines[i].second += bytes.size();
+                }
 
-            srcRB = (srcRB * srcA) >> 8;
-            srcG  = (srcG  * srcA) >> 8;
+                c->x0 = position.x; c->y0 = position.y;
+                c->mode = (uint8_t)mode;
+                c->value = wrapWidth;
+                c->ref = font_index(font);
+                c->first = (uint32_t)first;
+                c->count = (uint32_t)(lines.size() - first);
+                bytes.append(text);
+            }
 
-            uint32_t outRB = (srcRB + dstRB) & 0x00FF00FF;
-            uint32_t outG  = (srcG  + dstG ) & 0x0000FF00;
+            // only what's recorded after this lands inside pos/size (and inside
+            // the clip already pushed), until popClip()
+            void pushClip(vec2 pos, vec2 size) {
+                int x = (int)pos.x;
+                int y = (int)pos.y;
+                irect r = irect(x, y, x + (int)size.x, y + (int)size.y).intersect(clips[clip]);
+
+                // the same clip again is the same state, no new entry for it
+                clipStack.push_back(clip);
+                if (r.x0 != clips[clip].x0 || r.y0 != clips[clip].y0 || r.x1 != clips[clip].x1 || r.y1 != clips[clip].y1) {
+                    clip = (uint32_t)clips.size();
+                    clips.push_back(r);
+                }
+            }
 
-            dst = 0xFF000000 | outRB | outG;
-        }
+            void popClip() {
+                if (clipStack.empty())
+                    return;
+                clip = clipStack.back();
+                clipStack.pop_back();
+            }
 
-        inline void blit(Surface& target, const Surface& source, vec2 position, bool blend = true) {
-            target.blit(position, source, blend);
-        }
+            // forget every command, keeps the memory for the next frame
+            void clear() {
+                commands.clear();
+                sources.clear();
+                fonts.clear();
+                bytes.clear();
+                lines.clear();
+                clips.resize(1);
+                clipStack.clear();
+                clip = 0;
+                changed = true;
+            }
 
-        inline void line(Surface& surface, vec2 start, vec2 end,
-                        vec3 colour, float thickness = 1.0f) {
+            size_t size() const {
+                return commands.size();
+            }
 
-            int x0 = start.x;
-            int y0 = start.y;
-            int x1 = end.x;
-            int y1 = end.y;
+            // tiles are size x size pixels, 64 by default
+            void setTileSize(int size) {
+                tile = std::max(size, 8);
+                changed = true;
+            }
 
-            int dx = std::abs(x1 - x0);
-            int dy = std::abs(y1 - y0);
-            int sx = x0 < x1 ? 1 : -1;
-            int sy = y0 < y1 ? 1 : -1;
-            int err = dx - dy;
-            
-            while (true) {
-                int half = (int)(thickness * 0.5f);
-                for (int ty = -half; ty <= half; ++ty) {
-                    int py = y0 + ty;
-                    if (py < 0 || py >= surface.size.y) continue;
+            void submit(SurfaceView target) {
+                WINHELP_PROFILE_SCOPE("CommandBuffer::submit");
 
-                    for (int tx = -half; tx <= half; ++tx) {
-                        int px = x0 + tx;
-                        if (px < 0 || px >= surface.size.x) continue;
+                irect area = target.clipRect();
+                if (commands.empty() || area.empty())
+                    return;
 
-                        surface.pixels[(size_t)py * surface.size.x + px] =
-                            pack_colour(colour);
+                // a font that changed since text was recorded has other glyphs,
+                // they're loaded now, before any tile reads the font
+                for (const FontRef& ref : fonts) {
+                    if (ref.font->version() != ref.version) {
+                        relayout();
+                        changed = true;
+                        break;
                     }
                 }
 
-                if (x0 == x1 && y0 == y1) break;
+                if (changed || target.pixels != binned.pixels || target.size.x != binned.size.x ||
+                    target.size.y != binned.size.y || target.pitch != binned.pitch || !same(area, binned.clip)) {
+                    bin(target);
+                    changed = false;
+                }
 
-                int e2 = 2 * err;
-                if (e2 > -dy) { err -= dy; x0 += sx; }
-                if (e2 < dx)  { err += dx; y0 += sy; }
+                int across = binned.across;
+                jobs::parallel_for(0, (int)tileStart.size() - 1, 1, [&](int from, int to) {
+                    for (int t = from; t < to; ++t) {
+                        irect window = tile_rect(t, across).intersect(area);
+                        for (uint32_t i = tileStart[t]; i < tileStart[t + 1]; ++i)
+                            run(commands[entries[i]], target, area, window);
+                    }
+                });
             }
-        }
-
-        inline void rect(Surface& surface, vec2 pos,
-                        vec2 size, vec3 colour,
-                        bool filled = true,
-                        float thickness = 1.0f) {
 
-            if (not filled) {
-                line(surface, pos,
-                    { pos.x + size.x, pos.y }, colour, thickness);
+        private:
+            enum class op : uint8_t { fill, rect, circle, ring, line, stroke, blit, text };
+
+            // one draw call, plain data
+            struct Command {
+                op type;
+                uint8_t mode;     // blend_mode, or cap for lines
+                uint32_t clip;    // into clips, 0 is no clip
+                uint32_t colour;  // packed, text keeps its alpha in the top byte
+                irect bounds;     // every pixel it can touch, inside its clip
+                float x0, y0;     // position, centre, or where a line starts
+                float x1, y1;     // size, or where a line ends
+                float width;      // line thickness
+                int32_t value;    // circle radius, blit opacity, text wrap width
+                uint32_t ref;     // blit source or font
+                uint32_t first;   // text, its lines
+                uint32_t count;
+            };
+
+            struct FontRef {
+                const Font* font;
+                uint32_t version;
+            };
+
+            struct Binned {
+                uint32_t* pixels = nullptr;
+                ivec2 size;
+                int pitch = 0;
+                irect clip;
+                int across = 0;
+            };
+
+            std::vector<Command> commands;
+            std::vector<SourceView> sources;
+            std::vector<FontRef> fonts;
+            std::string bytes;                 // every text command's text
+            std::vector<std::pair<size_t, size_t>> lines; // where it breaks, into bytes
+            std::vector<irect> clips;          // 0 is everything
+            std::vector<uint32_t> clipStack;
+            uint32_t clip = 0;
+            int tile = 64;
+
+            // commands per tile, tile t's are entries[tileStart[t]..tileStart[t + 1])
+            std::vector<uint32_t> tileStart;
+            std::vector<uint32_t> entries;
+            std::vector<uint32_t> firstLive;   // per tile, commands before it are covered
+            std::vector<uint32_t> cursor;      // per tile, while placing entries
+            Binned binned;
+            bool changed = true;
+
+            static irect everything() {
+                return irect(-(1 << 30), -(1 << 30), 1 << 30, 1 << 30);
+            }
 
-                line(surface,
-                    { pos.x + size.x, pos.y },
-                    { pos.x + size.x, pos.y + size.y },
-                    colour, thickness);
+            static int whole(float v) {
+                return (int)std::floor(std::clamp(v, -1e9f, 1e9f));
+            }
 
-                line(surface,
-                    { pos.x + size.x, pos.y + size.y },
-                    { pos.x, pos.y + size.y },
-                    colour, thickness);
+            static bool same(const irect& a, const irect& b) {
+                return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+            }
 
-                line(surface,
-                    { pos.x, pos.y + size.y },
-                    pos, colour, thickness);
-            } else {
-                int w = (int)size.x;
-                int h = (int)size.y;
-                int px = (int)pos.x;
-                int py = (int)pos.y;
+            static bool covers(const irect& outer, const irect& inner) {
+                return outer.x0 <= inner.x0 && outer.y0 <= inner.y0 && outer.x1 >= inner.x1 && outer.y1 >= inner.y1;
+            }
 
-                uint32_t packed = pack_colour(colour);
+            // nullptr for a command clipped away entirely, it isn't kept
+            Command* add(op type, uint32_t colour, irect bounds) {
+                bounds = bounds.intersect(clips[clip]);
+                if (bounds.empty())
+                    return nullptr;
+
+                Command c = {};
+                c.type = type;
+                c.clip = clip;
+                c.colour = colour;
+                c.bounds = bounds;
+                commands.push_back(c);
+                changed = true;
+                return &commands.back();
+            }
 
-                for (int y = 0; y < h; ++y) {
+            uint32_t font_index(const Font& font) {
+                for (size_t i = 0; i < fonts.size(); ++i)
+                    if (fonts[i].font == &font)
+                        return (uint32_t)i;
+                fonts.push_back({ &font, font.version() });
+                return (uint32_t)fonts.size() - 1;
+            }
 
-                    int drawY = py + y;
-                    if (drawY < 0 || drawY >= surface.size.y)
-                        continue;
+            // glyphs can hang past the line box, a line height of slack all round
+            static irect text_bounds(const Font& font, vec2 position, ivec2 extent) {
+                int slack = font.lineHeight;
+                int x = (int)position.x;
+                int y = (int)position.y;
+                return irect(x - slack, y - slack, x + extent.x + slack, y + extent.y + slack);
+            }
 
-                    int startX = px;
-                    int endX   = px + w;
+            // every text wrapped again with the fonts as they are now
+            void relayout() {
+                std::vector<std::pair<size_t, size_t>> old;
+                old.swap(lines);
 
-                    if (endX < 0 || startX >= surface.size.x)
+                for (Command& c : commands) {
+                    if (c.type != op::text)
                         continue;
 
-                    startX = std::max(startX, 0);
-                    endX   = std::min(endX, surface.size.x);
+                    size_t begin = old[c.first].first;
+                    size_t end = old[c.first + c.count - 1].second;
+                    const Font& font = *fonts[c.ref].font;
 
-                    uint32_t* row =
-                        &surface.pixels[(size_t)drawY * surface.size.x + startX];
+                    size_t first = lines.size();
+                    ivec2 extent = font.extent(std::string_view(bytes).substr(begin, end - begin), c.value, lines);
+                    for (size_t i = first; i < lines.size(); ++i) {
+                        lines[i].first += begin;
+                        lines[i].second += begin;
+                    }
 
-                    for (int x = startX; x < endX; ++x)
-                        *row++ = packed;
+                    c.first = (uint32_t)first;
+                    c.count = (uint32_t)(lines.size() - first);
+                    c.bounds = text_bounds(font, { c.x0, c.y0 }, extent).intersect(clips[c.clip]);
                 }
-            }
-    }
-
-    inline void circle(Surface& surface, vec2 center, int radius, vec3 colour, bool filled = true) {
-            int cx = (int)center.x;
-            int cy = (int)center.y;
 
-            int r2 = radius * radius;
+                for (FontRef& ref : fonts)
+                    ref.version = ref.font->version();
+            }
 
-            for (int y = -radius; y <= radius; ++y) {
+            irect tile_rect(int t, int across) const {
+                int x = (t % across) * tile;
+                int y = (t / across) * tile;
+                return irect(x, y, x + tile, y + tile);
+            }
 
-                int yy = y * y;
-                int xSpan = (int)std::sqrt((float)(r2 - yy));
+            // fills and filled rects write every pixel of their area outright
+            bool opaque(const Command& c) const {
+                return c.type == op::fill || c.type == op::rect;
+            }
 
-                int drawY = cy + y;
-                if (drawY < 0 || drawY >= surface.size.y)
-                    continue;
+            template <typename F>
+            void for_tiles(const irect& bounds, const irect& area, int across, F&& fn) {
+                irect r = bounds.intersect(area);
+                if (r.empty())
+                    return;
+                for (int ty = r.y0 / tile; ty <= (r.y1 - 1) / tile; ++ty)
+                    for (int tx = r.x0 / tile; tx <= (r.x1 - 1) / tile; ++tx)
+                        fn(ty * across + tx);
+            }
 
-                if (filled) {
+            // a line only goes through the tiles along it, not all of its box:
+            // per row of tiles, the columns its padded band crosses
+            template <typename F>
+            void for_line_tiles(const Command& c, const irect& area, int across, F&& fn) {
+                irect r = c.bounds.intersect(area);
+                if (r.empty())
+                    return;
+
+                float pad = c.type == op::stroke ? c.width + 2.0f : 2.0f;
+                float dy = c.y1 - c.y0;
+
+                for (int ty = r.y0 / tile; ty <= (r.y1 - 1) / tile; ++ty) {
+                    float lo = std::min(c.x0, c.x1), hi = std::max(c.x0, c.x1);
+                    if (std::abs(dy) > 1e-3f) {
+                        float t0 = std::clamp((ty * tile - pad - c.y0) / dy, 0.0f, 1.0f);
+                        float t1 = std::clamp(((ty + 1) * tile + pad - c.y0) / dy, 0.0f, 1.0f);
+                        float xa = c.x0 + t0 * (c.x1 - c.x0), xb = c.x0 + t1 * (c.x1 - c.x0);
+                        lo = std::min(xa, xb);
+                        hi = std::max(xa, xb);
+                    }
 
-                    int startX = cx - xSpan;
-                    int endX   = cx + xSpan;
+                    int x0 = std::max(r.x0, whole(lo - pad));
+                    int x1 = std::min(r.x1 - 1, whole(hi + pad));
+                    for (int tx = x0 / tile; x0 <= x1 && tx <= x1 / tile; ++tx)
+                        fn(ty * across + tx);
+                }
+            }
 
-                    if (endX < 0 || startX >= surface.size.x)
-                        continue;
+            template <typename F>
+            void for_command_tiles(const Command& c, const irect& area, int across, F&& fn) {
+                if (c.type == op::line || c.type == op::stroke)
+                    for_line_tiles(c, area, across, fn);
+                else
+                    for_tiles(c.bounds, area, across, fn);
+            }
 
-                    startX = std::max(startX, 0);
-                    endX   = std::min(endX, surface.size.x - 1);
+            void bin(SurfaceView target) {
+                WINHELP_PROFILE_SCOPE("CommandBuffer::bin");
 
-                    uint32_t packed = pack_colour(colour);
-                    uint32_t* row = &surface.pixels[(size_t)drawY * surface.size.x + startX];
+                irect area = target.clipRect();
+                int across = (target.size.x + tile - 1) / tile;
+                int down = (target.size.y + tile - 1) / tile;
+                size_t tiles = (size_t)across * down;
 
-                    for (int x = startX; x <= endX; ++x)
-                        *row++ = packed;
+                binned = { target.pixels, target.size, target.pitch, area, across };
 
-                } else {
+                // the last command in each tile that hides everything before it
+                firstLive.assign(tiles, 0);
+                for (uint32_t i = 0; i < commands.size(); ++i) {
+                    const Command& c = commands[i];
+                    if (!opaque(c))
+                        continue;
+                    irect drawn = c.bounds.intersect(area);
+                    for_tiles(c.bounds, area, across, [&](int t) {
+                        if (covers(drawn, tile_rect(t, across).intersect(area)))
+                            firstLive[t] = i;
+                    });
+                }
 
-                    int x1 = cx - xSpan;
-                    int x2 = cx + xSpan;
+                // count, then place (commands stay in recorded order per tile)
+                tileStart.assign(tiles + 1, 0);
+                for (uint32_t i = 0; i < commands.size(); ++i)
+                    for_command_tiles(commands[i], area, across, [&](int t) {
+                        if (i >= firstLive[t])
+                            tileStart[t + 1]++;
+                    });
+                for (size_t t = 0; t < tiles; ++t)
+                    tileStart[t + 1] += tileStart[t];
+
+                entries.resize(tileStart[tiles]);
+                cursor.assign(tileStart.begin(), tileStart.end() - 1);
+                for (uint32_t i = 0; i < commands.size(); ++i)
+                    for_command_tiles(commands[i], area, across, [&](int t) {
+                        if (i >= firstLive[t])
+                            entries[cursor[t]++] = i;
+                    });
+            }
 
-                    put_pixel(surface, x1, drawY, colour);
-                    put_pixel(surface, x2, drawY, colour);
+            void run(const Command& c, SurfaceView target, const irect& area, const irect& window) const {
+                irect clipTo = c.clip ? area.intersect(clips[c.clip]) : area;
+                target.clip = window.intersect(clipTo);
+                if (target.clip.empty())
+                    return;
+
+                vec3 rgb = vec3((float)((c.colour >> 16) & 0xFF), (float)((c.colour >> 8) & 0xFF), (float)(c.colour & 0xFF));
+
+                switch (c.type) {
+                    case op::fill:
+                        target.fill(c.colour);
+                        break;
+                    case op::rect:
+                        draw::rect(target, { c.x0, c.y0 }, { c.x1, c.y1 }, rgb);
+                        break;
+                    case op::circle:
+                    case op::ring:
+                        draw::circle(target, { c.x0, c.y0 }, c.value, rgb, c.type == op::circle);
+                        break;
+                    case op::stroke:
+                        draw::line(target, { c.x0, c.y0 }, { c.x1, c.y1 }, rgb, c.width, (cap)c.mode);
+                        break;
+                    case op::line:
+                        // clipped the way the whole line would be, drawn a tile at a time
+                        internal_raster::thin_segment(target, clipTo, { c.x0, c.y0 }, { c.x1, c.y1 },
+                            c.colour, true, &target.clip);
+                        break;
+                    case op::blit:
+                        target.blit({ c.x0, c.y0 }, sources[c.ref], (blend_mode)c.mode, c.value);
+                        break;
+                    case op::text:
+                        // tiles run at once, so only drawLines: it never loads a
+                        // glyph (recording, or relayout, already loaded them all)
+                        fonts[c.ref].font->drawLines(target, { c.x0, c.y0 }, bytes, &lines[c.first], c.count,
+                            vec4(rgb.x, rgb.y, rgb.z, (float)(c.colour >> 24)), (blend_mode)c.mode);
+                        break;
                 }
             }
-        }
+        };
     }
 
+#ifdef _WIN32
     inline events::key map_key(WPARAM keyCode) {
         switch (keyCode) {
             // Letters
@@ -1070,13 +6629,42 @@ namespace winhelp {
                 return 0;
             }
 
+            // UTF-16 units, a codepoint past U+FFFF comes as two WM_CHARs
             case WM_CHAR: {
+                static uint32_t high = 0;
+                uint32_t unit = (uint32_t)wparam;
+
+                if (unit >= 0xD800 && unit <= 0xDBFF) {
+                    high = unit;
+                    return 0;
+                }
+
+                uint32_t codepoint = unit;
+                if (unit >= 0xDC00 && unit <= 0xDFFF)
+                    codepoint = high ? 0x10000 + ((high - 0xD800) << 10) + (unit - 0xDC00) : utf8::replacement;
+                high = 0;
+
+                queue().push_back({
+                    eventTypes::charin,
+                    { 0, 0 },
+                    events::key::none,
+                    events::mouse::none,
+                    codepoint
+                });
+                return 0;
+            }
+
+            // whole codepoints, from IMEs and other apps' input
+            case WM_UNICHAR: {
+                if (wparam == UNICODE_NOCHAR)
+                    return TRUE;
+
                 queue().push_back({
                     eventTypes::charin,
                     { 0, 0 },
                     events::key::none,
                     events::mouse::none,
-                    (wchar_t)wparam
+                    (uint32_t)wparam
                 });
                 return 0;
             }
@@ -1085,6 +6673,7 @@ namespace winhelp {
                 return DefWindowProcW(handle, message, wparam, lparam);
         }
     }
+#endif
 
 
     inline float fps = 0;
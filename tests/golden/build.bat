@@ -0,0 +1,11 @@
+@echo off
+REM Builds the golden-image runner and checks every scene, exits non zero on a
+REM visual diff or a slowdown. Extra args go to the runner (e.g. --update).
+g++ -std=c++20 -O2 main.c++ -lgdi32 -luser32 -o golden.exe
+if errorlevel 1 (
+    echo [BUILD]: Build failed.
+    exit /b 1
+)
+echo [BUILD]: Build succeeded!
+
+golden.exe %*
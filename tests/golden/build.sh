@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds the golden-image runner and checks every scene, exits non zero on a
+# visual diff or a slowdown. Extra args go to the runner (e.g. --update).
+set -e
+cd "$(dirname "$0")"
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+
+"$CXX" -std=c++20 $CXXFLAGS main.c++ -o golden
+echo "[BUILD]: Build succeeded!"
+
+./golden "$@"
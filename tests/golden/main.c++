@@ -0,0 +1,1003 @@
+// Headless golden-image + timing regression runner.
+//
+//   golden [--update] [--filter text] [--tolerance n] [--max-slowdown x]
+//
+// Every scene is drawn into a Surface through the normal draw:: / blit
+// calls and compared against images/<scene>.ppm. A channel may be off by
+// --tolerance before the pixel counts as different, any different pixel
+// fails the scene (the actual image and a diff are written to out/).
+//
+// Scene timings live in images/timings.csv next to the images, a scene
+// that gets slower than baseline * --max-slowdown fails too (0 turns the
+// check off). --update rewrites images and timings from the current build.
+//
+// Last, every scene is drawn once more and must not take any pixel buffer
+// from the heap (see winhelp::pool).
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "../../src/ver3/winhelp.hpp"
+#include "../../3dtest/render3d/render3d.hpp"
+using namespace winhelp;
+
+struct Scene {
+    const char* name;
+    ivec2 size;
+    void (*draw)(Surface&);
+    bool (*available)() = nullptr; // false skips the scene, for ones needing files off the system
+};
+
+// a test pattern for things to be blitted over
+static Surface checker(int w, int h, int cell) {
+    Surface s({ (float)w, (float)h });
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            s.pixels[(size_t)y * w + x] = ((x / cell + y / cell) & 1) ? 0xFF505060 : 0xFFB0B0C0;
+    return s;
+}
+
+static Surface gradient_sprite(int w, int h) {
+    Surface s({ (float)w, (float)h });
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            uint32_t a = (uint32_t)(x * 255 / (w - 1));
+            if (y < 4) a = 0;
+            if (y >= h - 4) a = 255;
+            s.pixels[(size_t)y * w + x] = (a << 24) | ((y * 255 / (h - 1)) << 16) | (0x30 << 8) | 0xE0;
+        }
+    }
+    s.hasAlpha = true;
+    return s;
+}
+
+static void scene_rects(Surface& s) {
+    s.fill(vec3(20, 20, 30));
+    draw::rect(s, { 10, 10 }, { 60, 40 }, { 255, 0, 0 });
+    draw::rect(s, { -20, 80 }, { 70, 30 }, { 0, 255, 0 });
+    draw::rect(s, { 150, -10 }, { 80, 50 }, { 0, 0, 255 });
+    draw::rect(s, { 170, 100 }, { 100, 100 }, { 255, 255, 0 });
+    draw::rect(s, { 80, 60 }, { 50, 50 }, { 255, 0, 255 }, false);
+    draw::rect(s, { 20, 60 }, { 40, 40 }, { 0, 255, 255 }, false, 3);
+}
+
+static void scene_lines(Surface& s) {
+    s.fill(vec3(0, 0, 0));
+    vec2 c = { 96, 64 };
+    for (int i = 0; i < 16; ++i) {
+        float a = i * 3.14159265f / 8;
+        draw::line(s, c, { c.x + std::cos(a) * 60, c.y + std::sin(a) * 60 },
+                   { 255.0f, i * 16.0f, 255.0f - i * 16 });
+    }
+    draw::line(s, { -30, 120 }, { 220, 100 }, { 255, 255, 255 }, 3);
+    draw::line(s, { 5, 5 }, { 60, 30 }, { 0, 255, 0 }, 8);
+    draw::line(s, { 180, 10 }, { 180, 120 }, { 255, 128, 0 }, 2);
+}
+
+static void scene_lines_aa(Surface& s) {
+    s.fill(vec3(0, 0, 0));
+    vec2 c = { 56, 64 };
+    for (int i = 0; i < 12; ++i) {
+        float a = i * 3.14159265f / 6 + 0.1f;
+        draw::line_aa(s, c, { c.x + std::cos(a) * 50, c.y + std::sin(a) * 50 }, { 255, 255, 255 });
+    }
+    draw::line_aa(s, { 120, 20 }, { 180, 40 }, { 255, 80, 80 }, 10, draw::cap::butt);
+    draw::line_aa(s, { 120, 60 }, { 180, 80 }, { 80, 255, 80 }, 10, draw::cap::square);
+    draw::line_aa(s, { 120, 100 }, { 180, 120 }, { 80, 80, 255 }, 10, draw::cap::round);
+    draw::line(s, { 110, 5 }, { 185, 5 }, { 255, 255, 0 }, 4, draw::cap::round);
+    draw::line_aa(s, { 150, 70 }, { 230, 160 }, { 255, 0, 255 }, 6.5f, draw::cap::round);
+}
+
+static void scene_polyline(Surface& s) {
+    s.fill(vec3(0, 0, 0));
+
+    std::vector<vec2> wave;
+    for (int x = -20; x <= 212; x += 4)
+        wave.push_back({ (float)x, 20 + std::sin(x * 0.08f) * 14 });
+    draw::polyline(s, wave, { 255, 255, 255 });
+
+    std::vector<vec2> zigzag = { { 10, 60 }, { 40, 100 }, { 60, 55 }, { 75, 110 }, { 90, 60 } };
+    draw::polyline(s, zigzag, { 255, 80, 80 }, 7, false, draw::join::miter, draw::cap::square);
+
+    for (vec2& p : zigzag) p.x += 90;
+    draw::polyline(s, zigzag, { 80, 255, 80 }, 7, false, draw::join::round, draw::cap::round);
+
+    std::vector<vec2> triangle = { { 150, 40 }, { 185, 45 }, { 170, 70 } };
+    draw::polyline(s, triangle, { 80, 160, 255 }, 5, true, draw::join::bevel);
+
+    std::vector<vec2> segments = { { 5, 120 }, { 60, 122 }, { 70, 124 }, { 250, 90 }, { 100, 40 }, { 100, 40 } };
+    draw::line_list(s, segments, { 255, 200, 0 });
+}
+
+static void scene_circles(Surface& s) {
+    s.fill(vec3(30, 30, 40));
+    draw::circle(s, { 40, 40 }, 30, { 255, 80, 80 });
+    draw::circle(s, { 120, 60 }, 45, { 80, 255, 80 }, false);
+    draw::circle(s, { 0, 128 }, 40, { 80, 80, 255 });
+    draw::circle(s, { 190, 20 }, 25, { 255, 255, 80 });
+    draw::circle(s, { 150, 110 }, 3, { 255, 255, 255 });
+    draw::circle(s, { 160, 110 }, 1, { 255, 255, 255 }, false);
+}
+
+static void scene_shapes(Surface& s) {
+    s.fill(vec3(30, 30, 40));
+    draw::circle_aa(s, { 30.5f, 30.25f }, 22.3f, { 255, 80, 80 });
+    draw::circle_aa(s, { 80, 30 }, 20, { 80, 255, 80 }, false);
+    draw::circle_aa(s, { 130, 30 }, 20, { 80, 160, 255 }, false, 5);
+    draw::ellipse_aa(s, { 170, 30 }, { 18, 10 }, { 255, 255, 80 });
+    draw::ellipse(s, { 30, 90 }, { 26, 14 }, { 255, 120, 0 });
+    draw::ellipse(s, { 30, 90 }, { 20, 30 }, { 0, 200, 200 }, false);
+    draw::ellipse_aa(s, { 80, 90 }, { 10, 28 }, { 255, 0, 255 }, false, 2.5f);
+    draw::pie(s, { 125, 90 }, 28, 0.3f, 5.2f, { 255, 200, 0 });
+    draw::pie(s, { 130, 90 }, 28, 5.4f, 6.4f, { 200, 120, 0 });
+    draw::arc(s, { 170, 90 }, 20, -1.0f, 2.5f, { 255, 255, 255 }, 3);
+    draw::arc(s, { 170, 90 }, 12, 3.0f, 4.0f, { 120, 255, 120 });
+}
+
+static void scene_batch(Surface& s) {
+    s.fill(vec3(10, 10, 10));
+
+    // a bar chart and a particle field, partly off the edges
+    draw::RectBatch bars;
+    for (int i = 0; i < 40; ++i) {
+        float h = 20 + (i * 53 % 170);
+        bars.add({ -6.0f + i * 8.5f, 250 - h }, { 7, h + 10 }, vec3(40 + i * 5, 120, 255 - i * 5));
+    }
+    draw::rects(s, bars);
+
+    draw::CircleBatch dots;
+    uint32_t seed = 7;
+    for (int i = 0; i < 600; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        float x = (float)((seed >> 8) % 340) - 10;
+        float y = (float)((seed >> 4) % 260) - 10;
+        dots.add({ x, y }, (int)(seed >> 28) % 7, vec3(255, (float)(seed >> 20 & 0xFF), 60));
+    }
+    draw::circles(s, dots);
+}
+
+// every primitive drawn right across two nested clip rects, nothing may
+// land outside the inner one
+static void scene_clip(Surface& s) {
+    s.fill(vec3(20, 20, 30));
+    Surface sprite = gradient_sprite(80, 60);
+
+    s.pushClip({ 8, 8 }, { 176, 112 });
+    s.fill(vec3(40, 40, 60));
+    s.pushClip({ 24, 16 }, { 200, 90 }); // sticks out of the first one, gets cut
+
+    s.fill(vec3(60, 30, 30));
+    draw::rect(s, { 0, 0 }, { 60, 50 }, { 255, 0, 0 });
+    draw::rect(s, { 140, 80 }, { 60, 50 }, { 255, 120, 0 }, false, 3);
+    draw::line(s, { 0, 0 }, { 191, 127 }, { 255, 255, 255 });
+    draw::line(s, { 0, 127 }, { 191, 0 }, { 0, 255, 255 }, 5);
+    draw::line_aa(s, { 10, 60 }, { 190, 70 }, { 255, 255, 0 });
+    draw::line_aa(s, { 30, 120 }, { 180, 10 }, { 255, 0, 255 }, 4, draw::cap::round);
+    std::vector<vec2> zigzag = { { 0, 40 }, { 40, 100 }, { 80, 20 }, { 120, 110 }, { 191, 30 } };
+    draw::polyline(s, zigzag, { 0, 255, 0 }, 3, false, draw::join::round);
+    draw::circle(s, { 24, 100 }, 20, { 80, 80, 255 });
+    draw::circle(s, { 170, 20 }, 25, { 255, 255, 255 }, false);
+    draw::circle_aa(s, { 100, 16 }, 14.5f, { 0, 200, 120 });
+    draw::ellipse(s, { 96, 64 }, { 100, 30 }, { 200, 200, 0 }, false);
+    draw::pie(s, { 190, 64 }, 30, 1.5f, 4.5f, { 120, 0, 200 });
+    draw::arc(s, { 60, 64 }, 40, 0, 3.14159f, { 255, 160, 160 }, 2);
+    draw::polygon(s, { { vec2(150, 100), vec2(200, 140) }, { vec2(200, 140), vec2(120, 140) }, { vec2(120, 140), vec2(150, 100) } },
+                  { 0, 120, 255 });
+    s.blit({ 150, 40 }, sprite);
+    draw::put_pixel(s, 23, 50, { 255, 255, 255 }); // just outside
+    draw::put_pixel(s, 24, 50, { 255, 255, 255 });
+
+    s.popClip();
+    draw::rect(s, { 0, 110 }, { 192, 20 }, { 0, 255, 0 }); // only the first clip now
+    s.popClip();
+    draw::rect(s, { 0, 124 }, { 40, 4 }, { 255, 255, 255 }); // none
+}
+
+// panes drawn straight into parts of the target through views
+static void scene_views(Surface& s) {
+    s.fill(vec3(20, 20, 30));
+    Surface sprite = checker(64, 64, 8);
+
+    // four tiles, each drawn in its own coordinates
+    for (int i = 0; i < 4; ++i) {
+        SurfaceView tile = s.view({ (float)(8 + (i % 2) * 92), (float)(8 + (i / 2) * 58) }, { 84, 52 });
+        tile.fill(draw::pack_colour(vec3(40 + i * 30, 40, 80)));
+        draw::circle(tile, { 42, 26 }, 30, { 255, 200, 0 }, false);
+        draw::line(tile, { -10, -10 }, { 100, 70 }, { 255, 255, 255 }, 3);
+        draw::rect(tile, { 60, 30 }, { 40, 40 }, { 0, 200, 100 });
+        draw::circle_aa(tile, { 10, 40 }, 12, { 255, 80, 80 });
+        tile.blit({ 30, 30 }, SurfaceView(sprite).sub({ 8, 8 }, { 24, 16 }));
+    }
+
+    // a view of a view, and the surface clip carried into it
+    s.pushClip({ 0, 0 }, { 150, 128 });
+    SurfaceView right = s.view({ 120, 90 }, { 72, 38 });
+    SurfaceView inner = right.sub({ 10, 4 }, { 100, 30 });
+    inner.fill(0xFF604020);
+    draw::polyline(inner, { { 0, 29 }, { 15, 0 }, { 30, 29 }, { 45, 0 }, { 60, 29 } }, { 255, 255, 255 }, 2);
+    s.popClip();
+}
+
+// drawing into padded surfaces (rows further apart than the width)
+// has to look the same as into packed ones
+static void scene_pitch(Surface& s) {
+    s.fill(vec3(20, 20, 30));
+
+    int x = 4;
+    for (int pitch : { 0, Surface::alignedPitch(57), 100 }) {
+        Surface panel({ 57, 120 }, pitch);
+        panel.fill(vec3(50, 50, 70));
+        draw::rect(panel, { 3, 3 }, { 51, 20 }, { 200, 60, 60 });
+        draw::circle(panel, { 28, 50 }, 22, { 60, 200, 60 });
+        draw::line(panel, { 0, 119 }, { 56, 70 }, { 255, 255, 255 }, 3);
+        draw::ellipse_aa(panel, { 28, 100 }, { 25, 12 }, { 80, 120, 255 });
+        s.blit({ (float)x, 4 }, panel);
+        x += 62;
+    }
+}
+
+static void scene_blit_opaque(Surface& s) {
+    static const Surface pattern = checker(64, 48, 8);
+    s.fill(vec3(10, 10, 10));
+    s.blit({ 10, 10 }, pattern);
+    s.blit({ -30, 70 }, pattern);
+    s.blit({ 160, -20 }, pattern);
+    s.blit({ 100, 100 }, pattern, false);
+}
+
+static void scene_blit_alpha(Surface& s) {
+    static const Surface background = checker(192, 128, 16);
+    static const Surface sprite = gradient_sprite(96, 64);
+    s.blit({ 0, 0 }, background);
+    s.blit({ 10, 10 }, sprite);
+    s.blit({ 120, 70 }, sprite);
+    s.blit({ -40, 80 }, sprite);
+    s.blit({ 60, 40 }, sprite, false);
+}
+
+// one cell per mode: the translucent sprite on top, an opaque ramp at
+// opacity 160 below it, both over the same checker
+static void scene_blend_modes(Surface& s) {
+    static const Surface background = checker(192, 128, 8);
+    static const Surface sprite = gradient_sprite(56, 28);
+    static const Surface ramp = [] {
+        Surface r({ 56, 28 });
+        for (int y = 0; y < 28; ++y)
+            for (int x = 0; x < 56; ++x)
+                r.row(y)[x] = draw::pack_colour(vec3((float)(x * 255 / 55), (float)(y * 255 / 27), 160));
+        return r;
+    }();
+
+    const blend_mode modes[] = {
+        blend_mode::alpha, blend_mode::add, blend_mode::multiply,
+        blend_mode::screen, blend_mode::min, blend_mode::max
+    };
+
+    s.blit({ 0, 0 }, background);
+    for (int i = 0; i < 6; ++i) {
+        float x = (float)(i % 3 * 64 + 4);
+        float y = (float)(i / 3 * 64 + 4);
+        draw::blit(s, sprite, { x, y }, modes[i]);
+        draw::blit(s, ramp, { x, y + 28 }, modes[i], 160);
+    }
+}
+
+static void scene_scaled(Surface& s) {
+    static const Surface tiny = checker(12, 9, 3);
+    static const Surface sprite = gradient_sprite(24, 16);
+    static const Surface fine = checker(120, 90, 1);
+    static const Surface bands = [] {
+        Surface b({ 90, 60 });
+        for (int y = 0; y < 60; ++y)
+            for (int x = 0; x < 90; ++x)
+                b.row(y)[x] = draw::pack_colour(vec3((float)(x * 255 / 89), (float)((x / 10 & 1) * 200), (float)(y * 4)));
+        return b;
+    }();
+
+    s.fill(vec3(30, 30, 40));
+
+    // growing: integer, fractional, translucent
+    draw::blit_scaled(s, tiny, { 4, 4 }, { 48, 36 }, draw::filter::nearest);
+    draw::blit_scaled(s, tiny, { 56, 4 }, { 41, 31 }, draw::filter::nearest);
+    draw::blit_scaled(s, tiny, { 100, 4 }, { 48, 36 }, draw::filter::bilinear);
+    draw::blit_scaled(s, sprite, { 150, 4 }, { 40, 60 }, draw::filter::bilinear);
+
+    // shrinking: a 1px checker boxes to flat grey, bands keep their shape
+    draw::blit_scaled(s, fine, { 4, 48 }, { 40, 30 }, draw::filter::box);
+    draw::blit_scaled(s, fine, { 48, 48 }, { 40, 30 }, draw::filter::nearest);
+    draw::blit_scaled(s, bands, { 92, 48 }, { 33, 22 }, draw::filter::box);
+    draw::blit_scaled(s, bands, { 92, 74 }, { 33, 22 }, draw::filter::bilinear);
+
+    // off the edge, and blended
+    draw::blit_scaled(s, bands, { 140, 80 }, { 90, 60 }, draw::filter::bilinear, blend_mode::add, 128);
+    draw::blit_scaled(s, sprite, { -20, 90 }, { 60, 50 }, draw::filter::box);
+}
+
+// mostly clear with a solid band and soft edges, what text and UI sprites look like
+static Surface ring_sprite(int size) {
+    Surface s({ (float)size, (float)size });
+    float c = size * 0.5f;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float d = std::fabs(std::hypot(x + 0.5f - c, y + 0.5f - c) - size * 0.35f);
+            float a = std::clamp((size * 0.08f - d) * 64, 0.0f, 255.0f);
+            s.row(y)[x] = ((uint32_t)a << 24) | ((x * 255 / size) << 16) | 0x40C0;
+        }
+    }
+    s.hasAlpha = true;
+    return s;
+}
+
+static void scene_rle(Surface& s) {
+    static const Surface ring = ring_sprite(56);
+    static const RleSurface compiled(ring);
+    static const RleSurface sprite(gradient_sprite(48, 32));
+    static const RleSurface tiles(checker(40, 30, 5));
+
+    s.fill(vec3(30, 30, 40));
+    draw::blit(s, compiled, { 4, 4 });
+    draw::blit(s, compiled, { 64, 4 }, blend_mode::add);
+    draw::blit(s, compiled, { 124, 4 }, blend_mode::alpha, 100);
+    draw::blit(s, sprite, { -16, 70 });
+    draw::blit(s, tiles, { 40, 66 });
+    draw::blit(s, sprite, { 60, 80 }, blend_mode::multiply);
+
+    s.pushClip({ 120, 64 }, { 50, 50 });
+    draw::blit(s, compiled, { 140, 80 });
+    s.popClip();
+}
+
+// the ring's coverage on its own, plus a strip that fades out left to right
+static void scene_mask(Surface& s) {
+    static const MaskSurface ring = [] {
+        Surface argb = ring_sprite(48);
+        MaskSurface m({ 48, 48 }, 64);
+        for (int y = 0; y < 48; ++y)
+            for (int x = 0; x < 48; ++x)
+                m.row(y)[x] = (uint8_t)(argb.row(y)[x] >> 24);
+        return m;
+    }();
+    static const MaskSurface fade = [] {
+        MaskSurface m({ 90, 10 });
+        for (int y = 0; y < 10; ++y)
+            for (int x = 0; x < 90; ++x)
+                m.row(y)[x] = (uint8_t)(255 - x * 255 / 89);
+        return m;
+    }();
+
+    s.fill(vec3(30, 30, 40));
+    draw::rect(s, { 96, 0 }, { 96, 128 }, { 200, 200, 210 });
+
+    draw::blit_mask(s, ring, { 4, 4 }, vec4(255, 80, 80, 255));
+    draw::blit_mask(s, ring, { 54, 4 }, vec4(80, 255, 120, 128));
+    draw::blit_mask(s, ring, { 104, 4 }, vec4(40, 60, 200, 255));
+    draw::blit_mask(s, ring, { 150, 4 }, vec4(255, 200, 0, 255), blend_mode::multiply);
+    draw::blit_mask(s, ring, { 20, 60 }, vec4(255, 120, 0, 255), blend_mode::add);
+    draw::blit_mask(s, ring, { 170, 100 }, vec4(0, 0, 0, 255)); // off the edge
+
+    for (int i = 0; i < 5; ++i)
+        draw::blit_mask(s, fade, { 80, (float)(60 + i * 12) }, vec4(50.0f * i, 255, 255 - 50.0f * i, 255));
+}
+
+// a made up font for the atlas: every glyph a box with a soft diagonal
+// through it, sized by its codepoint so neighbours differ
+static bool box_glyph(uint32_t c, GlyphAtlas::Bitmap& out) {
+    if (c == ' ') {
+        out.advance = 5;
+        return true;
+    }
+    if (c < 33 || c > 126)
+        return false;
+
+    int w = 4 + c % 5;
+    int h = 7 + c % 4;
+    out.coverage = MaskSurface({ (float)w, (float)h });
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            bool edge = x == 0 || y == 0 || x == w - 1 || y == h - 1;
+            int diagonal = 255 - std::abs(x * h - y * w) * 255 / (w + h);
+            out.coverage.row(y)[x] = (uint8_t)(edge ? 255 : std::max(0, diagonal));
+        }
+    }
+    out.offset = { 0, 12 - h };
+    out.advance = w + 1;
+    return true;
+}
+
+static void scene_atlas(Surface& s) {
+    static GlyphAtlas atlas = [] {
+        GlyphAtlas a(64); // narrow, so the sheet has to grow
+        a.lineHeight = 14;
+        a.rasterize = box_glyph;
+        a.setKerning('A', 'V', -3);
+        a.setKerning('V', 'A', -3);
+        return a;
+    }();
+
+    s.fill(vec3(30, 30, 40));
+    atlas.draw(s, { 4, 4 }, "Hello, atlas!", vec4(255, 255, 255, 255));
+    atlas.draw(s, { 4, 20 }, "AVAVAV kerned AV", vec4(255, 200, 80, 255));
+    atlas.draw(s, { 4, 36 }, "0123456789 {}[]()<>", vec4(120, 200, 255, 160));
+    atlas.draw(s, { 4, 52 }, "glow glow glow", vec4(255, 60, 60, 255), blend_mode::add);
+    atlas.draw(s, { -10, 68 }, "clipped at both ends of the line, far too long", vec4(80, 255, 120, 255));
+    atlas.draw(s, { 4, 122 }, "half off the bottom", vec4(255, 255, 255, 255));
+
+    // coverage into a mask, then that mask drawn twice
+    ivec2 size = atlas.measure("mask me");
+    MaskSurface mask({ (float)size.x, (float)size.y });
+    atlas.coverage(mask, { 0, 0 }, "mask me");
+    draw::blit_mask(s, mask, { 4, 90 }, vec4(255, 120, 255, 255));
+    draw::blit_mask(s, mask, { 100, 90 }, vec4(120, 255, 255, 255));
+
+    // the sheet itself
+    draw::blit_mask(s, atlas.sheet, { 124, 4 }, vec4(200, 200, 200, 255));
+}
+
+// DejaVu Sans, which most Linux boxes have, or whatever WINHELP_TEST_FONT
+// points at (the golden image only matches DejaVu Sans 2.37)
+static const std::string& test_font_path() {
+    static const std::string path = [] {
+        const char* env = std::getenv("WINHELP_TEST_FONT");
+        return std::string(env ? env : "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf");
+    }();
+    return path;
+}
+
+static bool have_test_font() {
+    static const bool ok = TrueType(test_font_path()).ok();
+    return ok;
+}
+
+static void scene_truetype(Surface& s) {
+    static Font small(test_font_path(), 12);
+    static Font medium(test_font_path(), 20);
+    static Font large(test_font_path(), 44);
+
+    s.fill(vec3(250, 248, 240));
+    small.glyphs().draw(s, { 4, 2 }, "The quick brown fox jumps over", vec4(0, 0, 0, 255));
+    small.glyphs().draw(s, { 4, 16 }, "the lazy dog. 0123456789 !?&@#%", vec4(40, 40, 160, 255));
+    medium.glyphs().draw(s, { 4, 32 }, "AVATAR Wave To", vec4(160, 20, 20, 255));
+    medium.glyphs().draw(s, { 4, 54 }, "fi fl {[(|)]} ~$", vec4(20, 120, 40, 200));
+    large.glyphs().draw(s, { 4, 74 }, "Sg&Q", vec4(30, 30, 30, 255));
+    large.glyphs().draw(s, { 120, 74 }, "@j", vec4(255, 120, 0, 255), blend_mode::multiply);
+
+    // off every edge
+    medium.glyphs().draw(s, { -6, 112 }, "clipped clipped clipped", vec4(0, 0, 200, 255));
+    large.glyphs().draw(s, { 170, -20 }, "W", vec4(0, 160, 160, 255));
+}
+
+// one set of distance fields drawn from tiny to huge
+static void scene_sdf(Surface& s) {
+    static Font font(test_font_path(), 16);
+
+    s.fill(vec3(20, 24, 32));
+    float y = 0;
+    for (float size : { 7.0f, 10.5f, 16.0f, 27.0f }) {
+        font.drawScaled(s, { 4, y }, "Distance AV fields", size, vec4(230, 230, 230, 255));
+        y += font.sizeScaled("A", size).y;
+    }
+
+    font.drawScaled(s, { 2, y - 6 }, "Qg&", 64.0f, vec4(255, 140, 40, 255));
+    font.drawScaled(s, { 100, y }, "glow", 30.0f, vec4(40, 120, 255, 255), blend_mode::add);
+    font.drawScaled(s, { 130, 100 }, "W", 90.0f, vec4(120, 255, 120, 120)); // off the corner
+}
+
+// labels through a TextCache: recoloured, wrapped and drawn twice a frame
+static void scene_text_cache(Surface& s) {
+    static Font font(test_font_path(), 13);
+    static TextCache cache(64 << 10);
+
+    s.fill(vec3(240, 240, 240));
+    for (int i = 0; i < 3; ++i)
+        cache.draw(s, font, { 4, 4.0f + i * 16 }, "Press (Space) to shuffle", vec4(60.0f * i, 0, 200 - 60.0f * i, 255));
+
+    const char* paragraph = "Scroll up to add a number and down to remove one.\nWrapped to fit.";
+    cache.draw(s, font, { 4, 54 }, paragraph, vec4(0, 0, 0, 255), 110);
+    cache.draw(s, font, { 120, 54 }, paragraph, vec4(180, 0, 0, 255), 70);
+}
+
+// one wrapped paragraph in each alignment, then a console scrolled to its end inside a view
+static void scene_layout(Surface& s) {
+    static Font font(test_font_path(), 10);
+    static TextLayout text(font, 60);
+    static TextLayout console = [] {
+        TextLayout t(font, 88);
+        for (int i = 0; i < 500; ++i)
+            t.append("> entry " + std::to_string(i) + (i % 3 ? " ok\n" : " took a while to finish\n"));
+        t.setParagraph(498, "> edited in place");
+        return t;
+    }();
+
+    s.fill(vec3(245, 245, 235));
+    text.setText("Wrapped, aligned and\nmeasured once.");
+
+    const TextLayout::align aligns[] = { TextLayout::align::left, TextLayout::align::centre, TextLayout::align::right };
+    for (int i = 0; i < 3; ++i) {
+        text.setAlignment(aligns[i]);
+        draw::rect(s, { 2.0f + i * 63, 2 }, { 60, (float)text.size().y }, vec3(220, 225, 240));
+        text.draw(s, { 2.0f + i * 63, 2 }, vec4(20, 20, 60, 255));
+    }
+
+    SurfaceView panel = s.view({ 4, 60 }, { 184, 64 });
+    panel.fill(0xFF202020);
+    console.draw(panel, { 2, 64.0f - console.size().y }, vec4(120, 255, 120, 255));
+    console.setAlignment(TextLayout::align::right);
+    console.draw(panel, { 92, 64.0f - console.size().y }, vec4(255, 200, 80, 255));
+    console.setAlignment(TextLayout::align::left);
+}
+
+// Font::draw straight into the target: lines, wrapping and clips cutting through glyphs
+static void scene_font_draw(Surface& s) {
+    static Font font(test_font_path(), 13);
+
+    s.fill(vec3(236, 240, 246));
+    font.draw(s, { 4, 2 }, "No surface in between", vec4(20, 20, 20, 255));
+    font.draw(s, { 4, 18 }, "two lines\nfrom one string", vec4(160, 30, 30, 255));
+    font.draw(s, { 110, 18 }, "wrapped to fit a narrow box", vec4(30, 90, 30, 255), 76);
+
+    s.pushClip({ 10, 56 }, { 90, 23 }); // cuts the second line in half
+    font.draw(s, { 4, 56 }, "clipped through the\nmiddle of a line\nand gone", vec4(0, 0, 180, 255));
+    s.popClip();
+
+    SurfaceView panel = s.view({ 4, 84 }, { 184, 40 });
+    panel.fill(0xFF202830);
+    font.draw(panel, { -10, -6 }, "off the top and left edges\nof a view", vec4(255, 220, 120, 255));
+    font.draw(panel, { 100, 22 }, "glow glow", vec4(60, 120, 255, 255), 0, blend_mode::add);
+}
+
+// a frame recorded once into a CommandBuffer and submitted every run, in
+// 16px tiles so nearly everything crosses a tile edge
+static void scene_commands(Surface& s) {
+    static Font font(test_font_path(), 12);
+    static Surface sprite = gradient_sprite(50, 40);
+    static draw::CommandBuffer commands;
+
+    if (commands.size() == 0) {
+        commands.setTileSize(16);
+        commands.fill(vec3(30, 34, 44));
+        commands.rect({ 6, 6 }, { 50, 30 }, { 200, 60, 60 });
+        commands.rect({ 60, 6 }, { 50, 30 }, { 60, 200, 60 }, false, 3);
+        commands.circle({ 150, 24 }, 20, { 80, 120, 255 });
+        commands.circle({ 150, 24 }, 12, { 255, 255, 255 }, false);
+        commands.line({ 0, 127 }, { 191, 45 }, { 255, 220, 0 });
+        commands.line({ 3, 40 }, { 188, 125 }, { 255, 255, 255 });
+        commands.line({ 20, 120 }, { 90, 50 }, { 0, 200, 200 }, 6, draw::cap::round);
+        commands.blit(sprite, { 100, 60 });
+        commands.blit(sprite, { 120, 80 }, blend_mode::add, 160);
+
+        commands.pushClip({ 8, 44 }, { 80, 40 });
+        commands.fill(vec3(60, 40, 70));
+        commands.pushClip({ 8, 44 }, { 80, 40 }); // same clip again
+        commands.circle({ 20, 60 }, 30, { 255, 150, 0 });
+        commands.text(font, { 10, 46 }, "clipped text in a box", vec4(255, 255, 255, 255), 70);
+        commands.popClip();
+        commands.popClip();
+
+        commands.text(font, { 96, 110 }, "recorded once", vec4(255, 255, 140, 220));
+        commands.rect({ 170, 96 }, { 40, 40 }, { 90, 90, 90 }); // hides what's under it
+    }
+
+    commands.submit(s);
+}
+
+// DejaVu Serif from next to the test font, it lacks glyphs DejaVu Sans has
+static std::string serif_font_path() {
+    const std::string& sans = test_font_path();
+    return sans.substr(0, sans.find_last_of("/\\") + 1) + "DejaVuSerif.ttf";
+}
+
+static bool have_fallback_fonts() {
+    static const bool ok = have_test_font() && TrueType(serif_font_path()).ok();
+    return ok;
+}
+
+// UTF-8 through every text path: 2, 3 and 4 byte sequences, a broken one,
+// and glyphs Serif doesn't have coming from Sans
+static void scene_utf8(Surface& s) {
+    static Font sans(test_font_path(), 13);
+    static Font font(serif_font_path(), 14);
+    static TextLayout wrapped(sans, 90, TextLayout::align::right);
+    if (font.version() == 0) // first run
+        font.addFallback(sans);
+
+    s.fill(vec3(250, 250, 250));
+    font.glyphs().draw(s, { 4, 2 }, "Grüße, Ωμέγα, Жизнь", vec4(0, 0, 0, 255));
+    font.glyphs().draw(s, { 4, 20 }, "₡₢₣₤ → ☺ ‽", vec4(150, 0, 0, 255));
+    font.glyphs().draw(s, { 4, 38 }, "𐌀𐌁𐌂𐌃 old italic", vec4(0, 100, 0, 255));
+    font.glyphs().draw(s, { 4, 56 }, "bad \xff\xc3 bytes", vec4(0, 0, 150, 255));
+
+    wrapped.setText("ünïcödé wörds wräpped at spaces");
+    wrapped.draw(s, { 96, 74 }, vec4(90, 0, 120, 255));
+    sans.drawScaled(s, { 4, 80 }, "Ωé→", 30.0f, vec4(255, 120, 0, 255));
+}
+
+// sprite spun and scaled about its centre, which lands on `at`
+static mat2x3 around(const Surface& sprite, vec2 at, float radians, vec2 scale) {
+    vec2 half = vec2((float)sprite.size.x, (float)sprite.size.y) * 0.5f;
+    return mat2x3::translate(at) * mat2x3::rotate(radians) * mat2x3::scale(scale) * mat2x3::translate(half * -1);
+}
+
+static void scene_transformed(Surface& s) {
+    static const Surface tiles = checker(32, 24, 4);
+    static const Surface sprite = gradient_sprite(40, 28);
+
+    s.fill(vec3(30, 30, 40));
+
+    draw::blit_transformed(s, tiles, around(tiles, { 30, 30 }, 0.5f, { 1, 1 }), draw::filter::nearest);
+    draw::blit_transformed(s, tiles, around(tiles, { 90, 30 }, 0.5f, { 1, 1 }), draw::filter::bilinear);
+    draw::blit_transformed(s, tiles, around(tiles, { 150, 32 }, -1.2f, { 1.5f, 0.75f }));
+    draw::blit_transformed(s, sprite, around(sprite, { 30, 92 }, 2.5f, { 1, 1 }));
+    draw::blit_transformed(s, sprite, mat2x3::translate({ 60, 70 }) * mat2x3::shear({ 0.6f, 0 }), draw::filter::bilinear,
+        blend_mode::add);
+    draw::blit_transformed(s, tiles, around(tiles, { 170, 110 }, 0.8f, { 2, 2 }), draw::filter::nearest); // off the edge
+    draw::blit_transformed(s, tiles, mat2x3::scale({ 1, 0 })); // flat, draws nothing
+}
+
+static void scene_polygon(Surface& s) {
+    s.fill(vec3(0, 0, 0));
+
+    std::vector<std::array<vec2, 2>> star;
+    vec2 c = { 96, 64 };
+    std::vector<vec2> points;
+    for (int i = 0; i < 10; ++i) {
+        float a = i * 3.14159265f / 5 - 3.14159265f / 2;
+        float r = (i & 1) ? 22.0f : 58.0f;
+        points.push_back({ c.x + std::cos(a) * r, c.y + std::sin(a) * r });
+    }
+    for (size_t i = 0; i < points.size(); ++i)
+        star.push_back({ points[i], points[(i + 1) % points.size()] });
+    draw::polygon(s, star, { 255, 200, 0 });
+
+    draw::polygon(s, { { vec2(-20, 100), vec2(40, 140) }, { vec2(40, 140), vec2(30, 90) }, { vec2(30, 90), vec2(-20, 100) } },
+                  { 0, 160, 255 });
+}
+
+static void scene_render3d(Surface& s) {
+    static render3d::Renderer renderer = [] {
+        render3d::Renderer r(120.0f);
+        r.cameraPos = { -4.0f, -2.7f, -5.0f };
+        r.cameraRot = { 0.05f, -0.1f, 0.0f };
+        r.addObject(render3d::create::cube(1.0f, { 200, 60, 60 }));
+
+        render3d::Object back = render3d::create::cube(0.8f, { 60, 60, 200 });
+        for (auto& face : back.faces) {
+            for (auto& p : face.points)
+                p += vec3(1.2f, -0.8f, 2.0f);
+            face.recalcAvgZ();
+        }
+        r.addObject(back);
+        return r;
+    }();
+    s.fill(vec3(30, 30, 40));
+    renderer.render(s);
+}
+
+static const Scene scenes[] = {
+    { "rects",       { 192, 128 }, scene_rects },
+    { "lines",       { 192, 128 }, scene_lines },
+    { "lines_aa",    { 192, 128 }, scene_lines_aa },
+    { "polyline",    { 192, 128 }, scene_polyline },
+    { "circles",     { 192, 128 }, scene_circles },
+    { "shapes",      { 192, 128 }, scene_shapes },
+    { "batch",       { 320, 240 }, scene_batch },
+    { "clip",        { 192, 128 }, scene_clip },
+    { "views",       { 192, 128 }, scene_views },
+    { "pitch",       { 192, 128 }, scene_pitch },
+    { "blit_opaque", { 192, 128 }, scene_blit_opaque },
+    { "blit_alpha",  { 192, 128 }, scene_blit_alpha },
+    { "blend_modes", { 192, 128 }, scene_blend_modes },
+    { "scaled",      { 192, 128 }, scene_scaled },
+    { "transformed", { 192, 128 }, scene_transformed },
+    { "rle",         { 192, 128 }, scene_rle },
+    { "mask",        { 192, 128 }, scene_mask },
+    { "atlas",       { 192, 128 }, scene_atlas },
+    { "truetype",    { 192, 128 }, scene_truetype, have_test_font },
+    { "sdf",         { 192, 128 }, scene_sdf, have_test_font },
+    { "text_cache",  { 192, 128 }, scene_text_cache, have_test_font },
+    { "layout",      { 192, 128 }, scene_layout, have_test_font },
+    { "font_draw",   { 192, 128 }, scene_font_draw, have_test_font },
+    { "commands",    { 192, 128 }, scene_commands, have_test_font },
+    { "utf8",        { 192, 128 }, scene_utf8, have_fallback_fonts },
+    { "polygon",     { 192, 128 }, scene_polygon },
+    { "render3d",    { 192, 128 }, scene_render3d },
+};
+
+// binary PPM, alpha is dropped, the framebuffer is always opaque anyway
+static bool write_ppm(const std::string& path, const Surface& s) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    f << "P6\n" << s.size.x << " " << s.size.y << "\n255\n";
+    for (uint32_t p : s.pixels) {
+        char rgb[3] = { (char)((p >> 16) & 0xFF), (char)((p >> 8) & 0xFF), (char)(p & 0xFF) };
+        f.write(rgb, 3);
+    }
+    return (bool)f;
+}
+
+static bool read_ppm(const std::string& path, Surface& s) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    std::string magic;
+    int w = 0, h = 0, maxValue = 0;
+    f >> magic >> w >> h >> maxValue;
+    f.get();
+    if (magic != "P6" || maxValue != 255 || w <= 0 || h <= 0)
+        return false;
+
+    s = Surface({ (float)w, (float)h });
+    for (uint32_t& p : s.pixels) {
+        unsigned char rgb[3];
+        f.read((char*)rgb, 3);
+        p = 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+    }
+    return (bool)f;
+}
+
+static std::map<std::string, double> read_timings(const std::string& path) {
+    std::map<std::string, double> timings;
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t comma = line.find(',');
+        if (comma == std::string::npos || line.compare(0, comma, "scene") == 0)
+            continue;
+        timings[line.substr(0, comma)] = std::atof(line.c_str() + comma + 1);
+    }
+    return timings;
+}
+
+static void write_timings(const std::string& path, const std::map<std::string, double>& timings) {
+    std::ofstream f(path);
+    f << "scene,ns_per_frame\n";
+    for (const auto& [name, ns] : timings)
+        f << name << "," << (long long)ns << "\n";
+}
+
+// fastest of a few batches, each long enough to time reliably, the
+// minimum is far less noisy than the mean on a busy machine
+static double time_scene(const Scene& scene) {
+    using clock = std::chrono::steady_clock;
+    Surface s({ (float)scene.size.x, (float)scene.size.y });
+
+    int reps = 1;
+    while (true) {
+        auto start = clock::now();
+        for (int i = 0; i < reps; ++i)
+            scene.draw(s);
+        if (clock::now() - start >= std::chrono::milliseconds(20) || reps >= (1 << 20))
+            break;
+        reps *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int batch = 0; batch < 7; ++batch) {
+        auto start = clock::now();
+        for (int i = 0; i < reps; ++i)
+            scene.draw(s);
+        samples.push_back(std::chrono::duration<double, std::nano>(clock::now() - start).count() / reps);
+    }
+
+    return *std::min_element(samples.begin(), samples.end());
+}
+
+int main(int argc, char** argv) {
+    std::string dir = "images";
+    std::string outDir = "out";
+    std::string filter;
+    bool update = false;
+    int tolerance = 0;
+    double maxSlowdown = 2.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--update") update = true;
+        else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc) tolerance = std::atoi(argv[++i]);
+        else if (arg == "--max-slowdown" && i + 1 < argc) maxSlowdown = std::atof(argv[++i]);
+        else if (arg == "--images" && i + 1 < argc) dir = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--update] [--filter text] [--tolerance n] [--max-slowdown x] [--images dir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::string timingsPath = dir + "/timings.csv";
+    std::map<std::string, double> baseline = read_timings(timingsPath);
+    std::map<std::string, double> timings = baseline;
+
+    int failures = 0;
+
+    for (const Scene& scene : scenes) {
+        if (!filter.empty() && std::string(scene.name).find(filter) == std::string::npos)
+            continue;
+
+        if (scene.available && !scene.available()) {
+            printf("[GOLDEN]: %-12s skipped  needs a file this machine doesn't have\n", scene.name);
+            continue;
+        }
+
+        Surface actual({ (float)scene.size.x, (float)scene.size.y });
+        scene.draw(actual);
+
+        double ns = time_scene(scene);
+        timings[scene.name] = ns;
+
+        std::string goldenPath = dir + "/" + scene.name + ".ppm";
+
+        if (update) {
+            if (!write_ppm(goldenPath, actual)) {
+                fprintf(stderr, "[GOLDEN]: could not write %s\n", goldenPath.c_str());
+                return 1;
+            }
+            printf("[GOLDEN]: %-12s updated  %10.0f ns\n", scene.name, ns);
+            continue;
+        }
+
+        Surface golden;
+        if (!read_ppm(goldenPath, golden)) {
+            printf("[GOLDEN]: %-12s FAIL     missing %s (run with --update)\n", scene.name, goldenPath.c_str());
+            failures++;
+            continue;
+        }
+
+        if (golden.size.x != actual.size.x || golden.size.y != actual.size.y) {
+            printf("[GOLDEN]: %-12s FAIL     size %dx%d, golden is %dx%d\n", scene.name,
+                   actual.size.x, actual.size.y, golden.size.x, golden.size.y);
+            failures++;
+            continue;
+        }
+
+        Surface diff({ (float)actual.size.x, (float)actual.size.y });
+        size_t badPixels = 0;
+        int worst = 0;
+
+        for (size_t i = 0; i < actual.pixels.size(); ++i) {
+            uint32_t a = actual.pixels[i];
+            uint32_t g = golden.pixels[i];
+
+            int delta = 0;
+            for (int shift = 0; shift < 24; shift += 8)
+                delta = std::max(delta, std::abs((int)((a >> shift) & 0xFF) - (int)((g >> shift) & 0xFF)));
+
+            worst = std::max(worst, delta);
+            if (delta > tolerance) {
+                badPixels++;
+                diff.pixels[i] = 0xFFFF0000;
+            } else {
+                // dimmed copy so the failing pixels stand out
+                diff.pixels[i] = 0xFF000000 | ((a >> 2) & 0x003F3F3F);
+            }
+        }
+
+        bool visualFail = badPixels > 0;
+        if (visualFail) {
+            std::string actualPath = outDir + "/" + scene.name + ".ppm";
+            std::string diffPath = outDir + "/" + scene.name + ".diff.ppm";
+            std::string mkdir = "mkdir -p " + outDir;
+#ifdef _WIN32
+            mkdir = "if not exist " + outDir + " mkdir " + outDir;
+#endif
+            std::system(mkdir.c_str());
+            write_ppm(actualPath, actual);
+            write_ppm(diffPath, diff);
+        }
+
+        bool slowFail = false;
+        double ratio = 0;
+        auto it = baseline.find(scene.name);
+        if (it != baseline.end() && it->second > 0) {
+            ratio = ns / it->second;
+            slowFail = maxSlowdown > 0 && ratio > maxSlowdown;
+        }
+
+        printf("[GOLDEN]: %-12s %-8s %10.0f ns", scene.name,
+               (visualFail || slowFail) ? "FAIL" : "ok", ns);
+        if (ratio > 0) printf("  x%.2f vs baseline", ratio);
+        if (visualFail) printf("  %zu pixels differ (worst %d), see %s/", badPixels, worst, outDir.c_str());
+        if (slowFail) printf("  slower than x%.2f", maxSlowdown);
+        printf("\n");
+
+        failures += visualFail || slowFail;
+    }
+
+    // every scene has run plenty of times by now, but its static sprites may
+    // have taken blocks a scene before it had given back. After one more warm
+    // pass the next must get all of its pixel buffers from the pool.
+    if (!update) {
+        for (int pass = 0; pass < 2; ++pass) {
+            pool::reset_counters();
+            for (const Scene& scene : scenes) {
+                if (!filter.empty() && std::string(scene.name).find(filter) == std::string::npos)
+                    continue;
+                if (scene.available && !scene.available())
+                    continue;
+
+                Surface target({ (float)scene.size.x, (float)scene.size.y });
+                scene.draw(target);
+            }
+        }
+
+        pool::Counters counters = pool::counters();
+        bool poolFail = counters.heapAllocations > 0;
+        printf("[GOLDEN]: %-12s %-8s %zu buffers reused, %zu from the heap\n", "pool",
+               poolFail ? "FAIL" : "ok", counters.reused, counters.heapAllocations);
+        failures += poolFail;
+
+        // every scene again with its fills, blits and polygons split over 4
+        // threads right down to single rows, it must match the serial run
+        std::vector<Surface> serial;
+        jobs::set_threads(1);
+        for (const Scene& scene : scenes) {
+            serial.emplace_back(vec2((float)scene.size.x, (float)scene.size.y));
+            if ((filter.empty() || std::string(scene.name).find(filter) != std::string::npos) &&
+                (!scene.available || scene.available()))
+                scene.draw(serial.back());
+        }
+
+        int minWork = jobs::min_work();
+        jobs::set_threads(4);
+        jobs::set_min_work(1);
+
+        std::string differ;
+        for (size_t i = 0; i < std::size(scenes); ++i) {
+            const Scene& scene = scenes[i];
+            if (!filter.empty() && std::string(scene.name).find(filter) == std::string::npos)
+                continue;
+            if (scene.available && !scene.available())
+                continue;
+
+            Surface threaded({ (float)scene.size.x, (float)scene.size.y });
+            scene.draw(threaded);
+            if (threaded.pixels != serial[i].pixels)
+                differ += std::string(" ") + scene.name;
+        }
+
+        jobs::set_threads(0);
+        jobs::set_min_work(minWork);
+
+        printf("[GOLDEN]: %-12s %-8s %s\n", "threads", differ.empty() ? "ok" : "FAIL",
+               differ.empty() ? "4 threads draw the same pixels as 1" : ("differs:" + differ).c_str());
+        failures += !differ.empty();
+
+        // a CommandBuffer with more clips than a 16 bit index holds, the
+        // last one must still clip
+        if (filter.empty() || std::string("commands").find(filter) != std::string::npos) {
+            draw::CommandBuffer commands;
+            for (int i = 0; i < 65535; ++i) {
+                commands.pushClip({ (float)(i % 200), (float)(i / 200 % 200) }, { 2, 2 });
+                commands.popClip();
+            }
+            commands.pushClip({ 0, 0 }, { 1, 1 });
+            commands.rect({ 0, 0 }, { 256, 256 }, { 255, 255, 255 });
+            commands.popClip();
+
+            Surface target({ 256, 256 });
+            commands.submit(target);
+            size_t drawn = 0;
+            for (uint32_t p : target.pixels)
+                drawn += p == 0xFFFFFFFF;
+
+            printf("[GOLDEN]: %-12s %-8s %zu pixel(s) drawn through the 65536th clip\n", "clips",
+                   drawn == 1 ? "ok" : "FAIL", drawn);
+            failures += drawn != 1;
+        }
+    }
+
+    if (update)
+        write_timings(timingsPath, timings);
+
+    if (failures) {
+        printf("[GOLDEN]: %d scene(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("[GOLDEN]: all scenes passed\n");
+    return 0;
+}